@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "Protocol/safeBuffer.h"
 #include "Protocol/IspProtocolDefs.h"
+#include "Protocol/IspProgress.h"
 
 uint8_t GuiCtrlLed_SubCmdProcess::LED_CTRL_STATE = 0;
 
@@ -13,21 +14,31 @@ Darin2::Darin2() {
 
 uint32_t Darin2::prepareForRx(const uint8_t* data, const uint8_t subcmd, uint32_t len)
 {
+    m_slotMask = 0;  // Only the *_MULTI subcommands report per-slot results
+
     if (subcmd == (uint8_t)IspSubCommand::D2_ERASE)
     {
     	m_Address_Flash_Page = ((data[0] + 256 * data[1]));
     	m_cartID = static_cast<CartridgeID>(data[5] - 1);
 
-    	pre_erase_flash(m_cartID);
-    	for (int i = 0; i < 1024; ++i)
-    	{
-            int BlockAddress = ((i << 5));
-    		unsigned char ans = flash_erase(BlockAddress, m_cartID);
-    		if(ans)
-    		 return ans;
-    	}
-    	post_erase_flash(m_cartID);
-    	return 0;
+    	return eraseChip(subcmd, (uint8_t)(1U << m_cartID)) ? 0xFF : 0;
+    }
+    else if(subcmd == (uint8_t)IspSubCommand::D2_ERASE_MULTI)
+    {
+      // Same parameters as D2_ERASE, with a slot bitmask in place of the cart number
+      m_slotMask = data[5] & 0x0F;
+      if (!m_slotMask)
+          return 1;
+
+      uint8_t failed = eraseChip(subcmd, m_slotMask);
+      for (int i = 0; i < ISP_MAX_SLOTS; ++i)
+      {
+          uint8_t bit = (uint8_t)(1U << i);
+          m_slotResult[i] = !(m_slotMask & bit) ? (uint8_t)IspReturnCodes::SUBCMD_NOTHANDLED
+                          : (failed & bit)      ? (uint8_t)IspReturnCodes::SUBCMD_FAILED
+                                                : (uint8_t)IspReturnCodes::SUBCMD_SUCESS;
+      }
+      return failed ? 1 : 0;
     }
     else if(subcmd == (uint8_t)IspSubCommand::D2_ERASE_BLOCK)
     {
@@ -38,54 +49,205 @@ uint32_t Darin2::prepareForRx(const uint8_t* data, const uint8_t subcmd, uint32_
     	post_erase_flash(m_cartID);
         return ans;
     }
+    else if(subcmd == (uint8_t)IspSubCommand::D2_WRITE_MULTI)
+    {
+      // Same parameters as D2_WRITE, with a slot bitmask in place of the cart number
+      m_Address_Flash_Page = ((data[0] + 256 * data[1]));
+      m_NumBlocks = data[2];
+      m_Last_Block_size = data[3] + 256 * data[4];
+      m_slotMask = data[5] & 0x0F;
+      m_ecc = (data[5] & ISP_D2_FLAG_ECC) != 0;
+
+      for (int i = 0; i < ISP_MAX_SLOTS; ++i)
+          m_slotResult[i] = (m_slotMask & (1U << i)) ? (uint8_t)IspReturnCodes::SUBCMD_SUCESS
+                                                     : (uint8_t)IspReturnCodes::SUBCMD_NOTHANDLED;
+      return m_slotMask ? 0 : 1;
+    }
     else
     {
       m_Address_Flash_Page = ((data[0] + 256 * data[1]));
       m_NumBlocks = data[2];
       m_Last_Block_size = data[3] + 256 * data[4];
-      m_cartID = static_cast<CartridgeID>(data[5] - 1);
+      m_ecc = (data[5] & ISP_D2_FLAG_ECC) != 0;
+      m_cartID = static_cast<CartridgeID>((data[5] & ~ISP_D2_FLAG_ECC) - 1);
 
+      // The read-back verify of an ECC write is reported like a one-slot D2_WRITE_MULTI
+      if (m_ecc)
+      {
+          m_slotMask = (uint8_t)(1U << m_cartID);
+          for (int i = 0; i < ISP_MAX_SLOTS; ++i)
+              m_slotResult[i] = (m_slotMask & (1U << i)) ? (uint8_t)IspReturnCodes::SUBCMD_SUCESS
+                                                         : (uint8_t)IspReturnCodes::SUBCMD_NOTHANDLED;
+      }
       return 0;
     }
 }
 
-uint8_t Darin2::processRxData(const uint8_t* data, const uint8_t subcmd, uint32_t len)
+uint8_t Darin2::getSlotResults(uint8_t* codes)
 {
+    if (!m_slotMask)
+        return 0;
+
+    memcpy(codes, m_slotResult, ISP_MAX_SLOTS);
+    m_slotMask = 0;  // Reported once, with the ACK_DONE of this transfer
+    return ISP_MAX_SLOTS;
+}
+
+// Erase every block that holds data on the selected slots.  A slot is
+// blank-checked while the others are still erasing, so an empty cartridge
+// costs reads only and four slots take little longer than one.  Sends one
+// PROGRESS step per block; returns the slots that failed.
+uint8_t Darin2::eraseChip(uint8_t subcmd, uint8_t slotMask)
+{
+    IspProgress::begin(subcmd, BLOCK_COUNT);
+
+    flash_gang_begin(slotMask);
+    for (int block = 0; block < BLOCK_COUNT; ++block)
+    {
+        flash_gang_erase_used(block * PAGES_PER_BLOCK);
+        IspProgress::update(block + 1);
+    }
+    uint8_t failed = flash_gang_end();
+
+    IspProgress::finish();
+    return failed;
+}
+
+// Erase the block and program the pages into every selected slot from the
+// one copy in rxBuffer.  flash_gang_* loads each slot while the others are
+// still busy, so four slots take little longer than one.
+uint8_t Darin2::writeMulti(const uint8_t* data, uint32_t len)
+{
+    // Nothing left to program on the end-of-transfer call
+    if (len == 0)
+        return 0;
+
     int rxOffset = 0;
     int currentPage = m_Address_Flash_Page;
 
-    pre_erase_flash(m_cartID);
-    flash_erase(currentPage, m_cartID);
-    post_erase_flash(m_cartID);
+    // As for D2_WRITE, blank blocks are not erased and all-0xFF pages are
+    // not programmed
+    flash_set_ecc(m_ecc);
+    flash_gang_begin(m_slotMask);
+    flash_gang_erase_used(currentPage);
 
     for (int i = 0; i < m_NumBlocks; ++i)
     {
-        pre_write_flash(m_cartID);
-        flash_write(&data[rxOffset], 512, currentPage, m_cartID);
-        post_write_flash(m_cartID);
+        if (!flash_page_blank(&data[rxOffset], 512))
+            flash_gang_write(&data[rxOffset], 512, currentPage);
         currentPage++;
         rxOffset += 512;
     }
 
     if (m_Last_Block_size > 0)
     {
-        pre_write_flash(m_cartID);
-        flash_write(&data[rxOffset], m_Last_Block_size, currentPage, m_cartID);
-        post_write_flash(m_cartID);
+        if (!flash_page_blank(&data[rxOffset], m_Last_Block_size))
+            flash_gang_write(&data[rxOffset], m_Last_Block_size, currentPage);
         rxOffset += m_Last_Block_size;
     }
 
+    uint8_t failed = flash_gang_end();
+    flash_set_ecc(0);
+
+    for (int i = 0; i < ISP_MAX_SLOTS; ++i)
+    {
+        if (!(m_slotMask & (1U << i)))
+            continue;
+        if ((failed & (1U << i)) || (m_ecc && !verifyWritten(static_cast<CartridgeID>(i), data)))
+        {
+            failed |= (uint8_t)(1U << i);
+            m_slotResult[i] = (uint8_t)IspReturnCodes::SUBCMD_FAILED;
+        }
+    }
+
     storedLength = rxOffset;
 
-    return 0;
+    return failed ? 1 : 0;
+}
+
+uint8_t Darin2::processRxData(const uint8_t* data, const uint8_t subcmd, uint32_t len)
+{
+    if (subcmd == (uint8_t)IspSubCommand::D2_WRITE_MULTI)
+        return writeMulti(data, len);
+
+    // The end-of-transfer call carries no data; the block was written with
+    // the data call and must not be erased and programmed again
+    if (len == 0)
+        return 0;
+
+    int currentPage = m_Address_Flash_Page;
+    int totalPages = m_NumBlocks + (m_Last_Block_size > 0 ? 1 : 0);
+
+    // A block that still reads blank needs no erase
+    pre_erase_flash(m_cartID);
+    if (!flash_block_blank(currentPage, m_cartID))
+        flash_erase(currentPage, m_cartID);
+    post_erase_flash(m_cartID);
+
+    uint8_t failed = 0;
+
+    flash_set_ecc(m_ecc);
+    pre_write_flash(m_cartID);
+    for (int i = 0; i < totalPages; ++i, ++currentPage)
+    {
+        uint16_t size = (i < m_NumBlocks) ? 512 : m_Last_Block_size;
+        const uint8_t* page = &data[i * 512];
+
+        // An erased page already reads 0xFF, so all-0xFF pages are left alone
+        if (flash_page_blank(page, size))
+            continue;
+
+        failed |= flash_write(page, size, currentPage, m_cartID);
+    }
+    post_write_flash(m_cartID);
+    flash_set_ecc(0);
+
+    if (!failed && m_ecc && !verifyWritten(m_cartID, data))
+        failed = 0xFF;
+    if (failed && m_ecc)
+        m_slotResult[m_cartID] = (uint8_t)IspReturnCodes::SUBCMD_FAILED;
+
+    storedLength = m_NumBlocks * 512 + m_Last_Block_size;
+
+    return failed ? 1 : 0;
+}
+
+// Read back the pages of this transfer from one slot and check each against
+// its ECC and against the data sent.  Blank pages were not programmed and are
+// skipped.  This takes the place of a host-side read and compare.
+bool Darin2::verifyWritten(CartridgeID id, const uint8_t* data)
+{
+    uint8_t page[PAGE_SIZE];
+    int totalPages = m_NumBlocks + (m_Last_Block_size > 0 ? 1 : 0);
+
+    for (int i = 0; i < totalPages; ++i)
+    {
+        uint16_t size = (i < m_NumBlocks) ? PAGE_SIZE : m_Last_Block_size;
+        const uint8_t* expected = &data[i * PAGE_SIZE];
+
+        if (flash_page_blank(expected, size))
+            continue;
+
+        pre_read_flash(id);
+        uint8_t res = flash_read_ecc(page, m_Address_Flash_Page + i, id);
+        post_read_flash(id);
+
+        if (res != NAND_ECC_OK || memcmp(page, expected, size) != 0)
+            return false;
+    }
+    return true;
 }
 
 uint8_t Darin2::prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen)
 {
+    if (subcmd == (uint8_t)IspSubCommand::D2_CART_COPY || subcmd == (uint8_t)IspSubCommand::D2_CART_COMPARE)
+        return cartCopy(data, subcmd, outLen);
+
     int addressFlashPage = data[0] + (data[1] << 8);
     int numBlocks = data[2];
     int lastBlockSize = data[3] + (data[4] << 8);
-    m_cartID = static_cast<CartridgeID>(data[5]-1);
+    bool ecc = (data[5] & ISP_D2_FLAG_ECC) != 0;
+    m_cartID = static_cast<CartridgeID>((data[5] & ~ISP_D2_FLAG_ECC) - 1);
 
     int totalBytesToRead = numBlocks * 512 + lastBlockSize;
     int totalFlashPages = (totalBytesToRead + 511) / 512;
@@ -106,8 +268,18 @@ uint8_t Darin2::prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint3
         }
 
         uint8_t tempPage[512] = {0};
-        flash_read(tempPage, readSize, addressFlashPage, m_cartID);
-        post_read_flash(m_cartID);
+        if (ecc)
+        {
+            uint8_t res = flash_read_ecc(tempPage, addressFlashPage, m_cartID);
+            post_read_flash(m_cartID);
+            if (res == NAND_ECC_UNCORRECTABLE)
+                return (uint8_t)IspReturnCodes::SUBCMD_FAILED;
+        }
+        else
+        {
+            flash_read(tempPage, readSize, addressFlashPage, m_cartID);
+            post_read_flash(m_cartID);
+        }
 
         if (!SafeWriteToTxBuffer(tempPage, bufferOffset, readSize))
         {
@@ -123,6 +295,106 @@ uint8_t Darin2::prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint3
     return 0;
 }
 
+// Cartridge to cartridge copy and compare, run entirely on the board.
+// data[0] = source slot (1-4), data[1] = destination slot mask,
+// data[2..3] = first block, data[4..5] = block count (0 = to the last block).
+// Progress goes out as PROGRESS frames; the TX data is an IspCartReport.
+uint8_t Darin2::cartCopy(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen)
+{
+    outLen = 0;
+    if (data[0] < 1 || data[0] > ISP_MAX_SLOTS)
+        return 1;
+
+    CartridgeID src = static_cast<CartridgeID>(data[0] - 1);
+    uint8_t dstMask = data[1] & 0x0F & ~(1U << src);
+    int firstBlock = data[2] + 256 * data[3];
+    int blocks = data[4] + 256 * data[5];
+
+    if (firstBlock >= BLOCK_COUNT)
+        return 1;
+    if (blocks == 0 || firstBlock + blocks > BLOCK_COUNT)
+        blocks = BLOCK_COUNT - firstBlock;
+
+    m_report.begin(dstMask);
+    IspProgress::begin(subcmd, (uint32_t)blocks * PAGES_PER_BLOCK);
+
+    if (dstMask)
+    {
+        if (subcmd == (uint8_t)IspSubCommand::D2_CART_COPY)
+            copyBlocks(src, dstMask, firstBlock, blocks);
+        else
+            compareBlocks(src, dstMask, firstBlock, blocks);
+    }
+
+    IspProgress::finish();
+    outLen = m_report.write();
+    return 0;
+}
+
+// Each destination block is erased, then every page is read from the source
+// and programmed into all destinations at once.  The source is read while
+// the destinations are still busy with the previous erase or program.
+void Darin2::copyBlocks(CartridgeID src, uint8_t dstMask, int firstBlock, int blocks)
+{
+    uint8_t page[PAGE_SIZE];
+    uint32_t done = 0;
+
+    flash_gang_begin(dstMask);
+    for (int block = firstBlock; block < firstBlock + blocks; ++block)
+    {
+        uint16_t pageAddress = block * PAGES_PER_BLOCK;
+        flash_gang_erase(pageAddress);
+
+        for (int i = 0; i < PAGES_PER_BLOCK; ++i, ++pageAddress)
+        {
+            pre_read_flash(src);
+            flash_read(page, PAGE_SIZE, pageAddress, src);
+            post_read_flash(src);
+
+            flash_gang_write(page, PAGE_SIZE, pageAddress);
+            IspProgress::update(++done);
+        }
+    }
+
+    uint8_t failed = flash_gang_end();
+    for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot)
+    {
+        if (failed & (1U << slot))
+            m_report.fail(slot);
+    }
+}
+
+// Every page that differs from the source is listed, per slot
+void Darin2::compareBlocks(CartridgeID src, uint8_t dstMask, int firstBlock, int blocks)
+{
+    uint8_t expected[PAGE_SIZE];
+    uint8_t actual[PAGE_SIZE];
+    uint32_t done = 0;
+    uint16_t pageAddress = firstBlock * PAGES_PER_BLOCK;
+
+    for (int i = 0; i < blocks * PAGES_PER_BLOCK; ++i, ++pageAddress)
+    {
+        pre_read_flash(src);
+        flash_read(expected, PAGE_SIZE, pageAddress, src);
+        post_read_flash(src);
+
+        for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot)
+        {
+            if (!(dstMask & (1U << slot)))
+                continue;
+
+            CartridgeID id = static_cast<CartridgeID>(slot);
+            pre_read_flash(id);
+            flash_read(actual, PAGE_SIZE, pageAddress, id);
+            post_read_flash(id);
+
+            if (memcmp(expected, actual, PAGE_SIZE) != 0)
+                m_report.mismatch(slot, pageAddress);
+        }
+        IspProgress::update(++done);
+    }
+}
+
 bool Darin2::TestDarinIIFlash(int startPage, int endPage, CartridgeID cartId)
 {
     const int PAGE_SIZE = 512;
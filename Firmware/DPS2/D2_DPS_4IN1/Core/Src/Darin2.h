@@ -1,6 +1,10 @@
 #pragma once
 #include "Protocol/IIspSubCommandHandler.h"
+#include "Protocol/IspCrc.h"
+#include "Protocol/IspCommandManager.h"
+#include "Protocol/IspCartReport.h"
 #include "Darin2Cart_Driver.h"
+#include "NandEcc.h"
 #include "version.h"
 #include "stm32f4xx_hal.h"
 #include "main.h"
@@ -12,9 +16,21 @@ public:
 	uint32_t prepareForRx(const uint8_t* data, const uint8_t subcmd,uint32_t len) override;
 	uint8_t processRxData(const uint8_t* data, const uint8_t subcmd, uint32_t len) override;
     uint8_t prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen) override;
+    uint8_t getSlotResults(uint8_t* codes) override;
 	bool TestDarinIIFlash(int startPage, int endPage, CartridgeID cartId);
 
 private:
+    static constexpr int PAGES_PER_BLOCK = 32;
+    static constexpr int BLOCK_COUNT = 1024;
+    static constexpr uint16_t PAGE_SIZE = 512;
+
+    uint8_t eraseChip(uint8_t subcmd, uint8_t slotMask);
+    uint8_t writeMulti(const uint8_t* data, uint32_t len);
+    bool verifyWritten(CartridgeID id, const uint8_t* data);
+    uint8_t cartCopy(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen);
+    void copyBlocks(CartridgeID src, uint8_t dstMask, int firstBlock, int blocks);
+    void compareBlocks(CartridgeID src, uint8_t dstMask, int firstBlock, int blocks);
+
     static constexpr uint32_t SIZE = 10240;
     uint8_t flashData[SIZE];
     uint32_t storedLength = 0;
@@ -25,6 +41,15 @@ private:
     int m_NumBlocks;
     int m_Last_Block_size;
     CartridgeID m_cartID;
+    bool m_ecc = false;     // ISP_D2_FLAG_ECC on the current write
+
+    // D2_WRITE_MULTI/D2_ERASE_MULTI: slots in use (bit n = CARTRIDGE_1 + n) and
+    // their IspReturnCodes, reported in ACK_DONE
+    uint8_t m_slotMask = 0;
+    uint8_t m_slotResult[ISP_MAX_SLOTS];
+
+    // D2_CART_COPY / D2_CART_COMPARE result, sent back as the TX data
+    IspCartReport m_report;
 };
 
 class FirmwareVersion_SubCmdProcess : public IIspSubCommandHandler {
@@ -46,6 +71,130 @@ public:
 private:
 };
 
+class LinkCaps_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	LinkCaps_SubCmdProcess(){};
+
+	// Advertises the large (v2) frame format; hosts that never ask keep
+	// talking v1 and are answered in v1
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		uint8_t data[6];
+		data[0] = ISP_FRAME_VERSION_LARGE;
+		data[1] = ISP_MAX_FRAME_PAYLOAD >> 8;
+		data[2] = ISP_MAX_FRAME_PAYLOAD & 0xFF;
+		data[3] = ISP_LARGE_CHUNK_SIZE >> 8;
+		data[4] = ISP_LARGE_CHUNK_SIZE & 0xFF;
+		data[5] = ISP_CRC_TYPE_CRC16_CCITT | ISP_CRC_TYPE_CRC32_MPEG2;
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::LINK_CAPS, &data[0] ,6);
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::LINK_CAPS;
+	}
+
+private:
+};
+
+class BusBenchmark_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	BusBenchmark_SubCmdProcess(){};
+
+	// Measures the data bus direction change on the device, for comparing
+	// firmware builds
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		uint32_t cycles = DataBus_TurnaroundCycles();
+		uint8_t data[4];
+		data[0] = (uint8_t)(cycles >> 24);
+		data[1] = (uint8_t)(cycles >> 16);
+		data[2] = (uint8_t)(cycles >> 8);
+		data[3] = (uint8_t)cycles;
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::BUS_BENCHMARK, &data[0] ,4);
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::BUS_BENCHMARK;
+	}
+};
+
+class CrcBenchmark_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	CrcBenchmark_SubCmdProcess(){};
+
+	// Checks every CRC engine against the bitwise reference and times them
+	// over the same buffer.  Answers [match][bytes 2B] and then the core
+	// cycles of crc8 bitwise, table, slice-by-4, crc16, crc32 table and
+	// crc32 hardware, 4 bytes big-endian each
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		IspCrcBenchResult bench;
+		IspCrc_Benchmark(bench);
+
+		const uint32_t cycles[6] = { bench.crc8BitwiseCycles, bench.crc8TableCycles, bench.crc8Slice4Cycles,
+		                             bench.crc16Cycles, bench.crc32TableCycles, bench.crc32HwCycles };
+		uint8_t data[3 + 6 * 4];
+		data[0] = bench.allMatch ? 1 : 0;
+		data[1] = (uint8_t)(bench.bytes >> 8);
+		data[2] = (uint8_t)bench.bytes;
+		for (int i = 0; i < 6; i++)
+		{
+			data[3 + 4 * i]     = (uint8_t)(cycles[i] >> 24);
+			data[3 + 4 * i + 1] = (uint8_t)(cycles[i] >> 16);
+			data[3 + 4 * i + 2] = (uint8_t)(cycles[i] >> 8);
+			data[3 + 4 * i + 3] = (uint8_t)cycles[i];
+		}
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::CRC_BENCHMARK, &data[0], sizeof(data));
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::CRC_BENCHMARK;
+	}
+};
+
+class DispatchBenchmark_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	DispatchBenchmark_SubCmdProcess(IspCommandManager& mgr) : m_mgr(mgr) {};
+
+	// Times handleData() over frames that no handler takes, so only the
+	// dispatch lookups are counted.  Answers [frames 2B], then the core
+	// cycles for a CMD_REQ with an unregistered subcommand and for an
+	// unclaimed command byte, 4 bytes big-endian each
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		IspDispatchBenchResult bench;
+		IspDispatch_Benchmark(m_mgr, bench);
+
+		const uint32_t cycles[2] = { bench.controlCycles, bench.unclaimedCycles };
+		uint8_t data[2 + 2 * 4];
+		data[0] = (uint8_t)(bench.frames >> 8);
+		data[1] = (uint8_t)bench.frames;
+		for (int i = 0; i < 2; i++)
+		{
+			data[2 + 4 * i]     = (uint8_t)(cycles[i] >> 24);
+			data[2 + 4 * i + 1] = (uint8_t)(cycles[i] >> 16);
+			data[2 + 4 * i + 2] = (uint8_t)(cycles[i] >> 8);
+			data[2 + 4 * i + 3] = (uint8_t)cycles[i];
+		}
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::DISPATCH_BENCHMARK, &data[0], sizeof(data));
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::DISPATCH_BENCHMARK;
+	}
+
+private:
+	IspCommandManager& m_mgr;
+};
+
 class BoardID_SubCmdProcess : public IIspSubCommandHandler {
 public:
 	BoardID_SubCmdProcess(){};
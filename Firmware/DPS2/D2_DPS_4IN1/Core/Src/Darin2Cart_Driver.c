@@ -20,6 +20,10 @@
 #include "stm32f4xx_hal.h"
 #include "main.h"
 #include "Darin2Cart_Driver.h"
+#include "DataBus.h"
+#include "Timing.h"
+#include "NandEcc.h"
+#include <string.h>
 
 /* Private Defines -----------------------------------------------------------*/
 
@@ -30,17 +34,40 @@
 #define F_WR  WE_Pin       /* Write Enable */
 #define F_RD  RE_Pin       /* Read Enable */
 
+/* Array operation limits from the K9K1G08 datasheet (maximum, not typical).
+ * R/B ends each wait as soon as the chip is done; these only bound it. */
+#define D2_tR_MAX_US     12U     /* Page read into the data register */
+#define D2_tPROG_MAX_US  500U    /* Page program */
+#define D2_tBERS_MAX_US  3000U   /* Block erase */
+
+/* Bus timings, minimum */
+#define D2_tCLS_NS       20U     /* CLE/ALE setup to WE rising */
+#define D2_tWP_NS        25U     /* WE pulse width */
+#define D2_tWH_NS        15U     /* WE high hold */
+#define D2_tDS_NS        20U     /* Data setup to WE rising */
+#define D2_tREA_NS       35U     /* RE low to data valid */
+#define D2_tREH_NS       15U     /* RE high hold */
+#define D2_tWHR_NS       60U     /* WE high to RE low */
+#define D2_tADL_NS       100U    /* Last address cycle to data loading */
+#define D2_tWB_NS        100U    /* Last WE rising edge to R/B low */
+
+/* Array geometry */
+#define D2_PAGE_SIZE        512U
+#define D2_PAGES_PER_BLOCK  32U
+
+/* Spare area use with ECC on: the first D2_SPARE_USED of its 16 bytes are
+ * loaded, byte 5 stays 0xFF as the factory bad block marker, and the marker
+ * byte tells a page with ECC from one written without */
+#define D2_SPARE_USED       8U
+#define D2_ECC_MARK_POS     4U
+#define D2_ECC_MARK         0x00U
+
+/* LED blink half-period */
+#define LED_BLINK_MS     160U
+
 /* Private Variables ---------------------------------------------------------*/
 
-/* NAND Flash Data Bus Pins (8-bit) */
-uint16_t M_D7  = D07_Pin;  /* Data bit 7 */
-uint16_t M_D6  = DB6_Pin;  /* Data bit 6 */
-uint16_t M_D5  = DB5_Pin;  /* Data bit 5 */
-uint16_t M_D4  = DB4_Pin;  /* Data bit 4 */
-uint16_t M_D3  = DB3_Pin;  /* Data bit 3 */
-uint16_t M_D2  = DB2_Pin;  /* Data bit 2 */
-uint16_t M_D1  = DB1_Pin;  /* Data bit 1 */
-uint16_t M_D0  = DB0_Pin;  /* Data bit 0 */
+/* NAND Flash Data Bus: DB0..DB7 on PE0..PE7, driven through DataBus.h */
 
 /* Cartridge Slot Pin Mappings - 4 slots */
 static const uint16_t CE_PINS[]    = { CE1_Pin, CE2_Pin, CE3_Pin, CE4_Pin };        /* Chip Enable pins */
@@ -52,10 +79,28 @@ static const uint16_t RED_LED[]    = { LED2_Pin, LED4_Pin, LED6_Pin, LED8_Pin };
 /* Slot Status Tracking */
 static uint8_t SLT_STATUS[] = { 1, 1, 1, 1 };
 
+/* Spare bytes holding the six ECC bytes, as Linux lays out small-page OOB */
+static const uint8_t ECC_SPARE_POS[NAND_ECC_BYTES] = { 0, 1, 2, 3, 6, 7 };
+
+/* Set by flash_set_ecc(): programming writes ECC into the spare area */
+static uint8_t eccEnabled;
+
+/* Gang programming: one program or erase may be in flight per slot */
+static uint8_t    gangMask;                  /* Slots taking part */
+static uint8_t    gangBusy;                  /* Slots with an operation in flight */
+static uint8_t    gangFailed;                /* Slots that failed or timed out */
+static deadline_t gangDeadline[4];           /* Datasheet limit of the operation in flight */
+
 /* Private Function Prototypes -----------------------------------------------*/
 static uint16_t get_ce_pin(CartridgeID id);
 static uint16_t get_rdy_pin(CartridgeID id);
 static uint16_t get_slt_pin(CartridgeID id);
+static uint8_t wait_ready(CartridgeID id, uint32_t max_us);
+static void issue_program(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page);
+static void issue_erase(uint16_t Address_Flash_Page);
+static uint8_t read_status(void);
+static void gang_settle(CartridgeID id);
+static void build_spare(const uint8_t* TempStorage, uint16_t dataLength, uint8_t* spare);
 
 /* Private Functions ---------------------------------------------------------*/
 
@@ -79,6 +124,27 @@ static uint16_t get_rdy_pin(CartridgeID id)
     return RDY_PINS[id];
 }
 
+/**
+ * @brief  Wait for the cartridge to release R/B after a read, program or
+ *         erase command
+ * @param  id: Cartridge identifier
+ * @param  max_us: Datasheet maximum for the operation
+ * @retval 0x00 once ready, 0xFF if R/B is still low after max_us
+ */
+static uint8_t wait_ready(CartridgeID id, uint32_t max_us)
+{
+    // R/B only drops tWB after the command, so do not sample it before then
+    deadline_t deadline = deadline_us(max_us);
+    delay_ns(D2_tWB_NS);
+
+    while (HAL_GPIO_ReadPin(GPIOC, get_rdy_pin(id)) != 1)
+    {
+        if (deadline_expired(&deadline))
+            return 0xFF;
+    }
+    return 0x00;
+}
+
 /**
  * @brief  Get Slot Status pin for specified cartridge
  * @param  id: Cartridge identifier
@@ -164,15 +230,54 @@ void pre_write_flash(CartridgeID id)
 }
 
 /**
- * @brief  Write data to NAND flash memory
- * @param  TempStorage: Pointer to data buffer
- * @param  dataLength: Number of bytes to write
- * @param  Address_Flash_Page: Page address in flash
- * @param  id: Cartridge slot identifier
+ * @brief  Turn ECC in the spare area on or off for the pages programmed from
+ *         now on, by flash_write() and flash_gang_write()
+ * @param  enable: Non-zero to write ECC
+ * @retval None
+ */
+void flash_set_ecc(uint8_t enable)
+{
+    eccEnabled = enable;
+}
+
+/**
+ * @brief  Spare bytes for a page written with ECC
+ * @param  dataLength: Bytes of data; the rest of the page is 0xFF
  * @retval None
  */
-void flash_write(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page,CartridgeID id)
+static void build_spare(const uint8_t* TempStorage, uint16_t dataLength, uint8_t* spare)
 {
+    uint8_t ecc[NAND_ECC_BYTES];
+
+    nand_ecc_calculate(TempStorage, dataLength, ecc);
+    memset(spare, 0xFF, D2_SPARE_USED);
+    for (unsigned i = 0; i < NAND_ECC_BYTES; i++)
+        spare[ECC_SPARE_POS[i]] = ecc[i];
+    spare[D2_ECC_MARK_POS] = D2_ECC_MARK;
+}
+
+/**
+ * @brief  Load one page into the selected chip and start programming it
+ * @note   Returns as soon as the confirm command is latched; R/B stays low
+ *         for tPROG.
+ * @retval None
+ */
+static void issue_program(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page)
+{
+    uint8_t spare[D2_SPARE_USED];
+
+    if (eccEnabled)
+    {
+        build_spare(TempStorage, dataLength, spare);
+    }
+    else
+    {
+        // An unloaded byte keeps the erased 0xFF, so trailing 0xFF bytes and
+        // the rest of a short page are not clocked in at all
+        while (dataLength > 0 && TempStorage[dataLength - 1] == 0xFF)
+            dataLength--;
+    }
+
     HAL_GPIO_WritePin(GPIOD, F_CLE, 1);		   //activate the command latch enable
     write_port2(0x80);					       //send read command 0x80 to port p1
     HAL_GPIO_WritePin(GPIOD, F_WR, 0);		   //write the write command into the flash
@@ -202,38 +307,53 @@ void flash_write(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Addre
 
 	write_port2(0xFF);  				           //intially set the bits of port P1
 	HAL_GPIO_WritePin(GPIOD, F_ALE, 0);		   //disable address latch enable which indicates the end of write command for flash
-	short_delay_us(1000);					           //wait for some delay
+	delay_ns(D2_tADL_NS);  // ALE to data loading (tADL)
 
 	int x=0;
     for(x = 0;	x<dataLength;	x++)           //if data counter 'x'<	last_page_size then
 	{
 
-		write_port2(*TempStorage);                   //fetch the data from the XRAM loction
+		DataBus_Out(*TempStorage);                   //fetch the data from the XRAM loction
 	   	HAL_GPIO_WritePin(GPIOD, F_WR, 0);			//enable write signal of flash
 	   	HAL_GPIO_WritePin(GPIOD, F_WR, 1);			//disable write signal of flash
 	   	TempStorage++;				                //increment the pointer of XRAM
 	}
 
-    if(dataLength < 512)	//if last page size is less than 512 then
+    if (eccEnabled)
     {
-    for(x=0;x<(512-dataLength);x++)//fill the remaining by data 0xFF
-      {
-    	write_port2(0xFF);			                //send data 0xFF through port P1
-		HAL_GPIO_WritePin(GPIOD, F_WR, 0); 			//enable write signal
-		HAL_GPIO_WritePin(GPIOD, F_WR, 1);			//disable write signal
-      }
+        // The spare area follows column 511, so a short page is filled to reach it
+        for (unsigned col = dataLength; col < D2_PAGE_SIZE + D2_SPARE_USED; col++)
+        {
+            DataBus_Out(col < D2_PAGE_SIZE ? 0xFF : spare[col - D2_PAGE_SIZE]);
+            HAL_GPIO_WritePin(GPIOD, F_WR, 0);
+            HAL_GPIO_WritePin(GPIOD, F_WR, 1);
+        }
     }
 
-    short_delay_us(1000);					                //call delay function
-
     HAL_GPIO_WritePin(GPIOD, F_CLE, 1);				//enable command latch enable
     write_port2(0x10);			                    //initiate write command to flash so that the data from flash buffer
 
     HAL_GPIO_WritePin(GPIOD, F_WR, 0);				//enable write signal of flash
     HAL_GPIO_WritePin(GPIOD, F_WR, 1);   			//disable write signal
     HAL_GPIO_WritePin(GPIOD, F_CLE, 0); 			//disable command latch enable
-    short_delay_us(1000);					                //call delay function
 }
+
+/**
+ * @brief  Write data to NAND flash memory
+ * @param  TempStorage: Pointer to data buffer
+ * @param  dataLength: Number of bytes to write
+ * @param  Address_Flash_Page: Page address in flash
+ * @param  id: Cartridge slot identifier
+ * @retval 0x00 on success, 0xFF on timeout or if the status reports a failure
+ */
+uint8_t flash_write(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page,CartridgeID id)
+{
+    issue_program(TempStorage, dataLength, Address_Flash_Page);
+    if (wait_ready(id, D2_tPROG_MAX_US) != 0x00)     //R/B goes high when the page is programmed
+        return 0xFF;
+    return (read_status() & 0x01) ? 0xFF : 0x00;
+}
+
 //****************************************************************************
 //POST FLASH WRITE
 //****************************************************************************
@@ -314,11 +434,12 @@ void flash_read(uint8_t *TempStorage, uint16_t dataLength, uint16_t Address_Flas
 	write_port2(0xFF);				            // the end of of the address write
 	Configure_DataBus(0);			        //change the mode of port P1 as input port so that the
 	                                            //controller is now ready to recieve data from the port p1
-	short_delay_us(20000);				                //call delay function
+	wait_ready(id, D2_tR_MAX_US);			        //R/B goes high when the page is in the data register
 	for(uint16_t x = 0;	x<512;	x++)                    //if data counter(x)<512 then
 	{
 		HAL_GPIO_WritePin(GPIOD, F_RD, 0);		//activate the read enable signal of flash
-		*TempStorage = Read_port2();
+		delay_ns(D2_tREA_NS);  // RE to data valid (tREA)
+		*TempStorage = DataBus_In();
 		HAL_GPIO_WritePin(GPIOD, F_RD, 1);		//disable read enable
 		TempStorage++;			                            //increment XRAM pointer by one
 	}
@@ -326,6 +447,97 @@ void flash_read(uint8_t *TempStorage, uint16_t dataLength, uint16_t Address_Flas
 
 
 
+/**
+ * @brief  Read a page and check it against the ECC in its spare area
+ * @note   Same calling convention as flash_read(). RE keeps clocking past
+ *         column 511 into the spare area. A single flipped bit is corrected
+ *         in the buffer. A page without the ECC marker was written with ECC
+ *         off (or not at all) and is returned as read.
+ * @param  TempStorage: D2_PAGE_SIZE bytes of output
+ * @retval NandEccResult
+ */
+uint8_t flash_read_ecc(uint8_t* TempStorage, uint16_t Address_Flash_Page, CartridgeID id)
+{
+    uint8_t spare[D2_SPARE_USED];
+    uint8_t stored[NAND_ECC_BYTES];
+    uint8_t calc[NAND_ECC_BYTES];
+
+    flash_read(TempStorage, D2_PAGE_SIZE, Address_Flash_Page, id);
+    for (uint16_t x = 0; x < D2_SPARE_USED; x++)
+    {
+        HAL_GPIO_WritePin(GPIOD, F_RD, 0);
+        delay_ns(D2_tREA_NS);  // RE to data valid (tREA)
+        spare[x] = DataBus_In();
+        HAL_GPIO_WritePin(GPIOD, F_RD, 1);
+    }
+
+    if (spare[D2_ECC_MARK_POS] != D2_ECC_MARK)
+        return NAND_ECC_OK;
+
+    for (unsigned i = 0; i < NAND_ECC_BYTES; i++)
+        stored[i] = spare[ECC_SPARE_POS[i]];
+    nand_ecc_calculate(TempStorage, D2_PAGE_SIZE, calc);
+    return nand_ecc_correct(TempStorage, stored, calc);
+}
+
+/**
+ * @brief  Check whether a buffer is all 0xFF, i.e. what an erased page reads
+ * @note   Compares four words per step once aligned, so a 512-byte page is
+ *         about 32 iterations.
+ * @retval 1 if every byte is 0xFF, 0 otherwise
+ */
+uint8_t flash_page_blank(const uint8_t* buffer, uint16_t dataLength)
+{
+    const uint8_t* end = buffer + dataLength;
+
+    while (((uintptr_t)buffer & 3U) && buffer < end)
+    {
+        if (*buffer++ != 0xFF)
+            return 0;
+    }
+
+    const uint32_t* word = (const uint32_t*)buffer;
+    for (; (const uint8_t*)(word + 4) <= end; word += 4)
+    {
+        if ((word[0] & word[1] & word[2] & word[3]) != 0xFFFFFFFFU)
+            return 0;
+    }
+
+    for (buffer = (const uint8_t*)word; buffer < end; buffer++)
+    {
+        if (*buffer != 0xFF)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief  Check whether every page of a block reads back erased
+ * @note   The chip must be selected with the control lines idle, as after
+ *         pre_read_flash. Stops at the first page holding data, so a
+ *         programmed block usually costs a single page read. The bus is
+ *         left as an output.
+ * @param  Address_Flash_Page: Any page address within the block
+ * @param  id: Cartridge slot identifier
+ * @retval 1 if the block is blank, 0 otherwise
+ */
+uint8_t flash_block_blank(uint16_t Address_Flash_Page, CartridgeID id)
+{
+    uint32_t page[D2_PAGE_SIZE / 4];
+    uint16_t first = Address_Flash_Page & (uint16_t)~(D2_PAGES_PER_BLOCK - 1);
+    uint8_t blank = 1;
+
+    for (uint16_t i = 0; i < D2_PAGES_PER_BLOCK && blank; i++)
+    {
+        Configure_DataBus(1);                       // flash_read leaves it as an input
+        flash_read((uint8_t*)page, D2_PAGE_SIZE, first + i, id);
+        blank = flash_page_blank((const uint8_t*)page, D2_PAGE_SIZE);
+    }
+
+    Configure_DataBus(1);
+    return blank;
+}
+
 /**
  * @brief  Write 8-bit data to the NAND flash data bus
  * @param  data: 8-bit data to write
@@ -333,14 +545,7 @@ void flash_read(uint8_t *TempStorage, uint16_t dataLength, uint16_t Address_Flas
  */
 void write_port2(uint8_t data)
 {
-    HAL_GPIO_WritePin(GPIOE, M_D7, ((data & 0x80) >> 7));
-    HAL_GPIO_WritePin(GPIOE, M_D6, ((data & 0x40) >> 6));
-    HAL_GPIO_WritePin(GPIOE, M_D5, ((data & 0x20) >> 5));
-    HAL_GPIO_WritePin(GPIOE, M_D4, ((data & 0x10) >> 4));
-    HAL_GPIO_WritePin(GPIOE, M_D3, ((data & 0x08) >> 3));
-    HAL_GPIO_WritePin(GPIOE, M_D2, ((data & 0x04) >> 2));
-    HAL_GPIO_WritePin(GPIOE, M_D1, ((data & 0x02) >> 1));
-    HAL_GPIO_WritePin(GPIOE, M_D0, (data & 0x01));
+    DataBus_Out(data);
 }
 
 /**
@@ -349,31 +554,36 @@ void write_port2(uint8_t data)
  */
 uint8_t Read_port2(void)
 {
-    uint8_t ret =
-        (HAL_GPIO_ReadPin(GPIOE, M_D7) << 7) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D6) << 6) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D5) << 5) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D4) << 4) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D3) << 3) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D2) << 2) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D1) << 1) |
-        (HAL_GPIO_ReadPin(GPIOE, M_D0));
-
-    return ret;
+    return DataBus_In();
 }
 
 void Configure_DataBus(int io)
 {
-  switch(io)
-  {
-   case 0 :
-	   GPIOE->MODER &= ~0x0000FFFF;
-    break;
+  if (io)
+      DataBus_DirOut();
+  else
+      DataBus_DirIn();
+}
+
+/**
+ * @brief  Core cycles for one output/input turnaround of the data bus
+ * @note   Best of 8 runs, so an interrupt landing in one does not count.
+ *         Leaves the bus an input; call only with every read strobe idle.
+ */
+uint32_t DataBus_TurnaroundCycles(void)
+{
+    uint32_t best = UINT32_MAX;
 
-   case 1:
-	   GPIOE->MODER = (GPIOE->MODER & ~0x0000FFFF) | 0x00005555;
-	   break;
-  }
+    for (int run = 0; run < 8; run++)
+    {
+        uint32_t start = DWT->CYCCNT;
+        DataBus_DirOut();
+        DataBus_DirIn();
+        uint32_t cycles = DWT->CYCCNT - start;
+        if (cycles < best)
+            best = cycles;
+    }
+    return best;
 }
 
 void pre_erase_flash(CartridgeID id)
@@ -392,38 +602,38 @@ void pre_erase_flash(CartridgeID id)
 unsigned char flash_device_ID(CartridgeID id)
 {
 	HAL_GPIO_WritePin(GPIOD, F_CLE, 1);		   //activate the command latch enable
-	short_delay_us(1000);
+	delay_ns(D2_tCLS_NS);
 	write_port2(0x90);					       //send read command 0x80 to port p1
 	HAL_GPIO_WritePin(GPIOD, F_WR, 0);		   //write the write command into the flash
-	short_delay_us(1000);
+	delay_ns(D2_tWP_NS);
 	HAL_GPIO_WritePin(GPIOD, F_WR, 1);   	   //so that write command is intiated
 	HAL_GPIO_WritePin(GPIOD, F_CLE, 0);	       //disable command latch enable
-	short_delay_us(1000);
+	delay_ns(D2_tWH_NS);
 
 	HAL_GPIO_WritePin(GPIOD, F_ALE, 1);		   //activate address latch enable signal of flash
-	short_delay_us(1000);
+	delay_ns(D2_tCLS_NS);
 
 	write_port2((0x00) & 0xFF);                //send lower order 8 bit page address to port P1
 	HAL_GPIO_WritePin(GPIOD, F_WR, 0);		   //intiate write signal
-	short_delay_us(1000);
+	delay_ns(D2_tWP_NS);
 	HAL_GPIO_WritePin(GPIOD, F_WR, 1);
 
 	HAL_GPIO_WritePin(GPIOD, F_ALE, 0);		   //activate address latch enable signal of flash
 
 
 	Configure_DataBus(0);
-	short_delay_us(1000);
+	delay_ns(D2_tWHR_NS);
 	HAL_GPIO_WritePin(GPIOD, F_RD, 0);
-	short_delay_us(1000);
+	delay_ns(D2_tREA_NS);
 	unsigned char result = Read_port2();
 	HAL_GPIO_WritePin(GPIOD, F_RD, 1);
-	short_delay_us(1000);
+	delay_ns(D2_tREH_NS);
 
 	HAL_GPIO_WritePin(GPIOD, F_RD, 0);
-	short_delay_us(1000);
+	delay_ns(D2_tREA_NS);
 	result = Read_port2();
 	HAL_GPIO_WritePin(GPIOD, F_RD, 1);
-	short_delay_us(1000);
+	delay_ns(D2_tREH_NS);
 
 	return result;
 
@@ -432,13 +642,15 @@ unsigned char flash_device_ID(CartridgeID id)
 //FLASH ERASE
 //****************************************************************************
 
-unsigned char flash_erase(uint16_t Address_Flash_Page, CartridgeID id)
+/**
+ * @brief  Start erasing the block holding Address_Flash_Page on the
+ *         selected chip
+ * @note   Returns as soon as the confirm command is latched; R/B stays low
+ *         for tBERS.
+ * @retval None
+ */
+static void issue_erase(uint16_t Address_Flash_Page)
 {
-	unsigned char result = 0x00;
-	unsigned char answer;
-	uint32_t timeout_count = 0;
-	const uint32_t timeout_limit = 5000; // 5000 iterations × 1000us = 5 seconds
-
     HAL_GPIO_WritePin(GPIOD, F_CLE, 1);		             //activate the command latch enable
     write_port2(0x60);					                 //send read command 0x80 to port p1
     HAL_GPIO_WritePin(GPIOD, F_WR, 0);		             //write the write command into the flash
@@ -446,61 +658,68 @@ unsigned char flash_erase(uint16_t Address_Flash_Page, CartridgeID id)
     HAL_GPIO_WritePin(GPIOD, F_CLE, 0);	                 //disable command latch enable
 
 	HAL_GPIO_WritePin(GPIOD, F_ALE, 1);		             //activate address latch enable signal of flash
-	short_delay_us(1000);
 
 	write_port2((Address_Flash_Page) & 0xFF);            //send lower order 8 bit page address to port P1
 	HAL_GPIO_WritePin(GPIOD, F_WR, 0);		             //intiate write signal
 	HAL_GPIO_WritePin(GPIOD, F_WR, 1);
-	short_delay_us(1000);
 
 	write_port2((Address_Flash_Page >>8) & 0xFF);        //send higher order 8 bit page address to port P1
 	HAL_GPIO_WritePin(GPIOD, F_WR, 0);		             //initiate the write signal
 	HAL_GPIO_WritePin(GPIOD, F_WR, 1);
-	short_delay_us(1000);
 
 	write_port2(0x00);				                     //send address 0x00 to port P1
 	HAL_GPIO_WritePin(GPIOD, F_WR, 0);		             //initiate the write signal
 	HAL_GPIO_WritePin(GPIOD, F_WR, 1);
-	short_delay_us(1000);
 
 	HAL_GPIO_WritePin(GPIOD, F_ALE, 0);
 
 
 	HAL_GPIO_WritePin(GPIOD, F_CLE, 1);
-	short_delay_us(1000);
 	write_port2(0xD0);
 	HAL_GPIO_WritePin(GPIOD, F_WR, 0);
     HAL_GPIO_WritePin(GPIOD, F_WR, 1);
     HAL_GPIO_WritePin(GPIOD, F_CLE, 0);
-    short_delay_us(1000);
+}
 
-    //rdy - with 5 second timeout
-    while(HAL_GPIO_ReadPin(GPIOC, get_rdy_pin(id)) != 1)
-    {
-        short_delay_us(1000);  // 1ms delay per iteration
-        timeout_count++;
-        if(timeout_count >= timeout_limit)
-        {
-            return 0xFF;  // timeout error
-			//break;
-        }
-    }
+/**
+ * @brief  Read the status register of the selected chip
+ * @retval Status byte, bit 0 set if the last program or erase failed
+ */
+static uint8_t read_status(void)
+{
+	uint8_t result;
 
     write_port2(0x70);
-    short_delay_us(1000);
     HAL_GPIO_WritePin(GPIOD, F_CLE, 1);
     HAL_GPIO_WritePin(GPIOD, F_WR, 0);
-    short_delay_us(1000);
     HAL_GPIO_WritePin(GPIOD, F_WR, 1);
     HAL_GPIO_WritePin(GPIOD, F_CLE, 0);
 
     Configure_DataBus(0);
     HAL_GPIO_WritePin(GPIOD, F_RD, 0);
-    short_delay_us(1000);
+    delay_ns(D2_tREA_NS);  // RE to data valid (tREA)
     result = Read_port2();
     HAL_GPIO_WritePin(GPIOD, F_RD, 1);
     Configure_DataBus(1);
 
+    return result;
+}
+
+unsigned char flash_erase(uint16_t Address_Flash_Page, CartridgeID id)
+{
+	unsigned char result = 0x00;
+	unsigned char answer;
+
+    issue_erase(Address_Flash_Page);
+
+    //rdy - bounded by the datasheet block erase time
+    if(wait_ready(id, D2_tBERS_MAX_US) != 0x00)
+    {
+        return 0xFF;  // timeout error
+    }
+
+    result = read_status();
+
     if((result & 0x01)==0x01)
     {
        answer = 0xFF; //error
@@ -524,18 +743,182 @@ void post_erase_flash(CartridgeID id)			    //function deactivate control lines
 	Configure_DataBus(0);
  }
 
+//****************************************************************************
+//GANG PROGRAMMING
+//****************************************************************************
+// The slots share the data bus and strobes but each has its own CE and R/B.
+// The K9K1G08 keeps programming or erasing with CE high, so a slot is only
+// selected while its command and data go out; its tPROG/tBERS then runs
+// while the next slot is loaded.  A slot is only waited on when it is about
+// to be given its next operation, and its status is read then.
+
 /**
- * @brief  Microsecond delay function using NOP instructions
- * @param  us: Delay time in microseconds (approximate)
- * @note   Timing depends on CPU clock frequency
+ * @brief  Finish the operation in flight on a slot, if any
+ * @note   Waits on R/B up to the limit set when the operation was issued,
+ *         then reads the status register. A failure or timeout marks the
+ *         slot failed and it is skipped from then on.
+ * @param  id: Cartridge slot identifier
  * @retval None
  */
-void short_delay_us(uint32_t us)
+static void gang_settle(CartridgeID id)
 {
-    for (volatile uint32_t i = 0; i < us * 8; i++)
+    uint8_t bit = (uint8_t)(1U << id);
+
+    if (!(gangBusy & bit))
+        return;
+    gangBusy &= (uint8_t)~bit;
+
+    while (HAL_GPIO_ReadPin(GPIOC, get_rdy_pin(id)) != 1)
     {
-        __NOP();  /* One NOP ~1 cycle at system clock */
+        if (deadline_expired(&gangDeadline[id]))
+        {
+            gangFailed |= bit;
+            return;
+        }
     }
+
+    HAL_GPIO_WritePin(GPIOD, get_ce_pin(id), 0);
+    if (read_status() & 0x01)
+        gangFailed |= bit;
+    HAL_GPIO_WritePin(GPIOD, get_ce_pin(id), 1);
+}
+
+/**
+ * @brief  Prepare the bus for programming or erasing several slots at once
+ * @param  slotMask: Bit n selects CARTRIDGE_1 + n
+ * @retval None
+ */
+void flash_gang_begin(uint8_t slotMask)
+{
+    gangMask   = slotMask & 0x0F;
+    gangBusy   = 0;
+    gangFailed = 0;
+
+    Configure_DataBus(1);
+
+    HAL_GPIO_WritePin(GPIOD, F_ALE, 0);            /* Disable Address Latch Enable */
+    HAL_GPIO_WritePin(GPIOD, F_WP,  1);            /* Disable Write Protect */
+    HAL_GPIO_WritePin(GPIOD, F_RD,  1);            /* Disable Read Enable */
+    HAL_GPIO_WritePin(GPIOD, F_WR,  1);            /* Disable Write Enable */
+    HAL_GPIO_WritePin(GPIOD, F_CLE, 0);            /* Disable Command Latch Enable */
+    for (int itr = 0; itr < 4; itr++)
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 1);
+}
+
+/**
+ * @brief  Program the same page into every slot of the gang
+ * @note   Each slot is loaded while the others are still programming; the
+ *         call returns with the last slot's tPROG still running. A slot
+ *         outside the gang may be read with flash_read() between calls.
+ * @param  buffer: Pointer to data buffer
+ * @param  dataLength: Number of bytes to write, the rest of the page is 0xFF
+ * @param  pageAddress: Page address in flash
+ * @retval None
+ */
+void flash_gang_write(const uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress)
+{
+    Configure_DataBus(1);  // Another slot may have been read since the last call
+
+    for (int itr = 0; itr < 4; itr++)
+    {
+        uint8_t bit = (uint8_t)(1U << itr);
+        if (!(gangMask & bit))
+            continue;
+
+        gang_settle(itr);
+        if (gangFailed & bit)
+            continue;
+
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 0);
+        issue_program(buffer, dataLength, pageAddress);
+        gangDeadline[itr] = deadline_us(D2_tPROG_MAX_US);
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 1);
+        gangBusy |= bit;
+    }
+    delay_ns(D2_tWB_NS);  // R/B of the last slot must have dropped before it is polled
+}
+
+/**
+ * @brief  Erase the same block on every slot of the gang
+ * @note   The erases run concurrently; the call returns with all of them
+ *         still in progress.
+ * @param  pageAddress: Any page address within the block
+ * @retval None
+ */
+void flash_gang_erase(uint16_t pageAddress)
+{
+    Configure_DataBus(1);  // Another slot may have been read since the last call
+
+    for (int itr = 0; itr < 4; itr++)
+    {
+        uint8_t bit = (uint8_t)(1U << itr);
+        if (!(gangMask & bit))
+            continue;
+
+        gang_settle(itr);
+        if (gangFailed & bit)
+            continue;
+
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 0);
+        issue_erase(pageAddress);
+        gangDeadline[itr] = deadline_us(D2_tBERS_MAX_US);
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 1);
+        gangBusy |= bit;
+    }
+    delay_ns(D2_tWB_NS);  // R/B of the last slot must have dropped before it is polled
+}
+
+/**
+ * @brief  Erase a block on every slot of the gang where it holds data
+ * @note   Each slot is blank-checked once its previous operation is done,
+ *         while the other slots are still erasing. A blank block is left
+ *         alone, which saves tBERS and an erase cycle.
+ * @param  pageAddress: Any page address within the block
+ * @retval None
+ */
+void flash_gang_erase_used(uint16_t pageAddress)
+{
+    Configure_DataBus(1);  // Another slot may have been read since the last call
+
+    for (int itr = 0; itr < 4; itr++)
+    {
+        uint8_t bit = (uint8_t)(1U << itr);
+        if (!(gangMask & bit))
+            continue;
+
+        gang_settle(itr);
+        if (gangFailed & bit)
+            continue;
+
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 0);
+        if (!flash_block_blank(pageAddress, itr))
+        {
+            issue_erase(pageAddress);
+            gangDeadline[itr] = deadline_us(D2_tBERS_MAX_US);
+            gangBusy |= bit;
+        }
+        HAL_GPIO_WritePin(GPIOD, get_ce_pin(itr), 1);
+    }
+    delay_ns(D2_tWB_NS);  // R/B of the last slot must have dropped before it is polled
+}
+
+/**
+ * @brief  Wait for every slot of the gang to finish and release the bus
+ * @retval Bitmask of the slots that failed or timed out, 0 on success
+ */
+uint8_t flash_gang_end(void)
+{
+    for (int itr = 0; itr < 4; itr++)
+        gang_settle(itr);
+
+    HAL_GPIO_WritePin(GPIOD, F_ALE, 0);            /* Disable Address Latch Enable */
+    HAL_GPIO_WritePin(GPIOD, F_WP,  1);            /* Disable Write Protect */
+    HAL_GPIO_WritePin(GPIOD, F_RD,  1);            /* Disable Read Enable */
+    HAL_GPIO_WritePin(GPIOD, F_WR,  1);            /* Disable Write Enable */
+    HAL_GPIO_WritePin(GPIOD, F_CLE, 0);            /* Disable Command Latch Enable */
+    Configure_DataBus(0);
+
+    return gangFailed;
 }
 
 /**
@@ -585,10 +968,10 @@ void slotLedBlink(CartridgeID id, uint8_t value)
 	{
 		HAL_GPIO_WritePin(GPIOA, get_D2_Red_LedPins(id), GPIO_PIN_SET);
 		HAL_GPIO_WritePin(GPIOA, get_D2_Green_LedPins(id), GPIO_PIN_SET);
-		short_delay_us(500000);
+		delay_ms(LED_BLINK_MS);
 		HAL_GPIO_WritePin(GPIOA, get_D2_Red_LedPins(id), GPIO_PIN_RESET);
 		HAL_GPIO_WritePin(GPIOA, get_D2_Green_LedPins(id), GPIO_PIN_RESET);
-		short_delay_us(500000);
+		delay_ms(LED_BLINK_MS);
 		--value;
 	}
 }
@@ -609,10 +992,10 @@ uint8_t LedLoopBack(uint8_t value)
 		if(HAL_GPIO_ReadPin(GPIOB, LB4_Pin))
 			data = data | 0x08;
 
-		short_delay_us(500000);
+		delay_ms(LED_BLINK_MS);
 
 		 GPIOA->ODR ^= 0x1FE;
-		short_delay_us(500000);
+		delay_ms(LED_BLINK_MS);
 
 		if(HAL_GPIO_ReadPin(GPIOB, LB1_Pin))
 			data2 = data2 | 0x01;
@@ -645,11 +1028,11 @@ void BlinkAllLed(uint8_t value)
         /* Turn ON all LEDs */
         GPIOA->ODR = (GPIOA->ODR & 0x1FF00U) | 0x1FF;
 
-        short_delay_us(500000);  /* 500ms ON time */
+        delay_ms(LED_BLINK_MS);  /* ON time */
 
         /* Turn OFF all LEDs */
         GPIOA->ODR = (GPIOA->ODR & 0x1FF00U) | 0x00;
 
-        short_delay_us(500000);  /* 500ms OFF time */
+        delay_ms(LED_BLINK_MS);  /* OFF time */
     }
 }
@@ -43,10 +43,22 @@ extern "C" {
  * @brief Core NAND flash operations for read, write, and erase
  * @{
  */
-void flash_write(const uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress, CartridgeID id);
+uint8_t flash_write(const uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress, CartridgeID id);
 void flash_read(uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress, CartridgeID id);
 uint8_t flash_erase(uint16_t pageAddress, CartridgeID id);
 uint8_t flash_device_ID(CartridgeID id);
+uint8_t flash_page_blank(const uint8_t* buffer, uint16_t dataLength);
+uint8_t flash_block_blank(uint16_t pageAddress, CartridgeID id);
+/**
+ * @}
+ */
+
+/** @defgroup DARIN2_FLASH_Ecc Spare Area ECC
+ * @brief Hamming ECC (NandEcc.h) written with each page and checked on read
+ * @{
+ */
+void flash_set_ecc(uint8_t enable);
+uint8_t flash_read_ecc(uint8_t* buffer, uint16_t pageAddress, CartridgeID id);
 /**
  * @}
  */
@@ -65,14 +77,27 @@ void post_erase_flash(CartridgeID id);
  * @}
  */
 
+/** @defgroup DARIN2_FLASH_Gang Multi-Slot Programming
+ * @brief Program or erase up to four slots with their busy times overlapped
+ * @{
+ */
+void flash_gang_begin(uint8_t slotMask);
+void flash_gang_write(const uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress);
+void flash_gang_erase(uint16_t pageAddress);
+void flash_gang_erase_used(uint16_t pageAddress);
+uint8_t flash_gang_end(void);
+/**
+ * @}
+ */
+
 /** @defgroup DARIN2_GPIO_Control GPIO and Port Control
  * @brief Low-level GPIO and port manipulation functions
  * @{
  */
 void Configure_DataBus(int io);
+uint32_t DataBus_TurnaroundCycles(void);
 uint8_t Read_port2(void);
 void write_port2(uint8_t data);
-void short_delay_us(uint32_t us);
 /**
  * @}
  */
@@ -0,0 +1,79 @@
+/**
+ ******************************************************************************
+ * @file    DataBus.h
+ * @brief   Byte-wide access to the cartridge data bus for DPS2 4-in-1
+ ******************************************************************************
+ * @attention
+ *
+ * Copyright (c) 2023-2024 ISquare Systems
+ * All rights reserved.
+ *
+ * This software is licensed under terms that can be found in the LICENSE file
+ * in the root directory of this software component.
+ * If no LICENSE file comes with this software, it is provided AS-IS.
+ *
+ ******************************************************************************
+ */
+
+#ifndef DATABUS_H
+#define DATABUS_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* DB0..DB7 are PE0..PE7, so a byte maps straight onto the low half of the
+ * port: one BSRR store drives it and one IDR load samples it. */
+#ifndef __cplusplus
+_Static_assert((DB0_Pin | DB1_Pin | DB2_Pin | DB3_Pin |
+                DB4_Pin | DB5_Pin | DB6_Pin | D07_Pin) == 0x00FF,
+               "DataBus.h expects the data bus on PE0..PE7");
+#endif
+
+/**
+ * @brief  Drive a byte onto the data bus
+ * @note   Reset all eight lines and set the 1 bits in the same store; where
+ *         both are requested BSRR gives the set bit priority.
+ */
+static inline void DataBus_Out(uint8_t data)
+{
+    GPIOE->BSRR = (0xFFUL << 16) | data;
+}
+
+/**
+ * @brief  Sample the data bus
+ */
+static inline uint8_t DataBus_In(void)
+{
+    return (uint8_t)GPIOE->IDR;
+}
+
+/* MODER field of PE0..PE7, and 01 (general purpose output) in each pin */
+#define DATABUS_MODER_MASK  0x0000FFFFUL
+#define DATABUS_MODER_OUT   0x00005555UL
+
+/**
+ * @brief  One-time pad setup: push-pull, low speed, no pull
+ * @note   Call after MX_GPIO_Init(). Direction changes afterwards only
+ *         rewrite MODER.
+ */
+static inline void DataBus_Init(void)
+{
+    GPIOE->OTYPER  &= ~0x00FFUL;
+    GPIOE->OSPEEDR &= ~DATABUS_MODER_MASK;
+    GPIOE->PUPDR   &= ~DATABUS_MODER_MASK;
+}
+
+/**
+ * @brief  Turn the data bus around: one read-modify-write of MODER
+ */
+static inline void DataBus_DirOut(void)
+{
+    GPIOE->MODER = (GPIOE->MODER & ~DATABUS_MODER_MASK) | DATABUS_MODER_OUT;
+}
+
+static inline void DataBus_DirIn(void)
+{
+    GPIOE->MODER &= ~DATABUS_MODER_MASK;
+}
+
+#endif /* DATABUS_H */
@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * @file    NandEcc.h
+ * @brief   Hamming ECC for 512-byte NAND pages (1-bit correct, 2-bit detect)
+ ******************************************************************************
+ * @attention
+ *
+ * Copyright (c) 2023-2024 ISquare Systems
+ * All rights reserved.
+ *
+ * This software is licensed under terms that can be found in the LICENSE file
+ * in the root directory of this software component.
+ * If no LICENSE file comes with this software, it is provided AS-IS.
+ *
+ ******************************************************************************
+ */
+
+#ifndef NANDECC_H
+#define NANDECC_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exported Constants --------------------------------------------------------*/
+/* Three bytes per 256-byte half of a page, SmartMedia style: line parity,
+ * its complement, then the six column parity bits in bits 7..2.  Stored
+ * inverted, so an all-0xFF half has ECC FF FF FF. */
+#define NAND_ECC_PAGE_SIZE  512U
+#define NAND_ECC_BYTES      6U
+
+/* Exported Types ------------------------------------------------------------*/
+typedef enum
+{
+    NAND_ECC_OK = 0,            /* Data and ECC agree */
+    NAND_ECC_CORRECTED,         /* One bit flipped, in the data (fixed) or the ECC */
+    NAND_ECC_UNCORRECTABLE      /* Two or more bits flipped */
+} NandEccResult;
+
+/* Exported Functions --------------------------------------------------------*/
+void nand_ecc_calculate(const uint8_t* data, uint16_t dataLength, uint8_t* ecc);
+NandEccResult nand_ecc_correct(uint8_t* data, const uint8_t* stored, const uint8_t* calc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANDECC_H */
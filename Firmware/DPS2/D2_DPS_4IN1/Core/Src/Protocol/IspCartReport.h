@@ -0,0 +1,71 @@
+#pragma once
+#include "IspProtocolDefs.h"
+#include "safeBuffer.h"
+#include <cstdint>
+#include <cstring>
+
+// Result of an on-device cartridge copy or compare, returned as the TX data
+// of the subcommand (always ISP_CART_REPORT_SIZE bytes, zero padded):
+//   [retCode][slot1..slot4][mismatches 2B BE][entries]
+// Each slot byte is an IspReturnCodes value, SUBCMD_NOTHANDLED for a slot
+// that took no part.  Each entry is [slot][location 2B BE], the location
+// being a page on Darin-II or a file ID on Darin-III; only the first
+// ISP_CART_REPORT_MAX_ENTRIES are listed, the count keeps going.
+class IspCartReport {
+public:
+    void begin(uint8_t slotMask) {
+        mask_ = slotMask;
+        sourceFailed_ = false;
+        count_ = 0;
+        for (uint8_t i = 0; i < ISP_MAX_SLOTS; ++i)
+            results_[i] = static_cast<uint8_t>((slotMask & (1U << i)) ? IspReturnCodes::SUBCMD_SUCESS
+                                                                       : IspReturnCodes::SUBCMD_NOTHANDLED);
+    }
+
+    // The source slot could not be read: nothing was copied or compared
+    void failSource() { sourceFailed_ = true; }
+
+    void fail(uint8_t slot) { results_[slot] = static_cast<uint8_t>(IspReturnCodes::SUBCMD_FAILED); }
+
+    bool active(uint8_t slot) const {
+        return !sourceFailed_ && results_[slot] == static_cast<uint8_t>(IspReturnCodes::SUBCMD_SUCESS);
+    }
+
+    void mismatch(uint8_t slot, uint16_t location) {
+        fail(slot);
+        if (count_ < ISP_CART_REPORT_MAX_ENTRIES) {
+            entries_[count_][0] = slot + 1;
+            entries_[count_][1] = location >> 8;
+            entries_[count_][2] = location & 0xFF;
+        }
+        if (count_ < 0xFFFF) count_++;
+    }
+
+    // Writes the report to the start of txBuffer; returns its length
+    uint32_t write() const {
+        uint8_t out[ISP_CART_REPORT_SIZE];
+        memset(out, 0, sizeof(out));
+
+        bool failed = sourceFailed_ || !mask_;
+        for (uint8_t i = 0; i < ISP_MAX_SLOTS; ++i) {
+            if (results_[i] == static_cast<uint8_t>(IspReturnCodes::SUBCMD_FAILED)) failed = true;
+        }
+        out[0] = static_cast<uint8_t>(failed ? IspReturnCodes::SUBCMD_FAILED : IspReturnCodes::SUBCMD_SUCESS);
+        memcpy(&out[1], results_, ISP_MAX_SLOTS);
+        out[5] = count_ >> 8;
+        out[6] = count_ & 0xFF;
+
+        uint16_t listed = (count_ < ISP_CART_REPORT_MAX_ENTRIES) ? count_ : ISP_CART_REPORT_MAX_ENTRIES;
+        memcpy(&out[7], entries_, listed * 3);
+
+        SafeWriteToTxBuffer(out, 0, sizeof(out));
+        return sizeof(out);
+    }
+
+private:
+    uint8_t  mask_ = 0;
+    bool     sourceFailed_ = false;
+    uint8_t  results_[ISP_MAX_SLOTS];
+    uint16_t count_ = 0;
+    uint8_t  entries_[ISP_CART_REPORT_MAX_ENTRIES][3];
+};
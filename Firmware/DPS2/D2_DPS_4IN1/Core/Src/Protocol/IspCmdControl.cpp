@@ -9,6 +9,9 @@ IspCmdControl::IspCmdControl() : processor(nullptr), handlerCount(0)
     for (uint8_t i = 0; i < MAX_CONTROL_HANDLERS; i++) {
         subCmdHandlerList[i].valid = false;
     }
+    for (uint16_t c = 0; c < 256; c++) {
+        dispatch[c] = ISP_NO_HANDLER;
+    }
 }
 
 IspCmdControl::~IspCmdControl()
@@ -29,15 +32,6 @@ bool IspCmdControl::match(uint8_t cmd) {
     return cmd == static_cast<uint8_t>(IspCommand::CMD_REQ);
 }
 
-IIspSubCommandHandler* IspCmdControl::findHandler(IspSubCommand subCmd) {
-    for (uint8_t i = 0; i < handlerCount; i++) {
-        if (subCmdHandlerList[i].valid && subCmdHandlerList[i].subCmd == subCmd) {
-            return subCmdHandlerList[i].handler;
-        }
-    }
-    return nullptr;
-}
-
 void IspCmdControl::execute(uint8_t* data, uint32_t len)
 {
     uint8_t type = data[0];
@@ -67,6 +61,9 @@ void IspCmdControl::registerSubCmdHandlers(IIspSubCommandHandler* handler)
         subCmdHandlerList[handlerCount].subCmd = cmd;
         subCmdHandlerList[handlerCount].handler = handler;
         subCmdHandlerList[handlerCount].valid = true;
+        if (dispatch[static_cast<uint8_t>(cmd)] == ISP_NO_HANDLER) {
+            dispatch[static_cast<uint8_t>(cmd)] = handlerCount;
+        }
         handlerCount++;
     }
 }
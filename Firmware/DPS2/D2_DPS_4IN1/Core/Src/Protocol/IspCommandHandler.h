@@ -19,7 +19,7 @@ public:
     virtual void setTransport(IspTransportInterface* iface) { transport = iface; }
     virtual bool match(uint8_t cmd) = 0;
     virtual void execute(uint8_t* data, uint32_t len) = 0;
-    //virtual void tick() {}  // Optional background work
+    virtual void tick() {}  // Optional background work, called from the main loop
     virtual ~IspCommandHandler() = default;
 
 protected:
@@ -0,0 +1,179 @@
+#include "IspCrc.h"
+
+#ifdef STM32F411xE
+#include "stm32f4xx.h"
+#include "Timing.h"
+#endif
+
+// Lookup tables are generated at compile time and live in flash
+
+struct Crc8Tables {
+    uint8_t t[4][256];   // t[k][i]: CRC of byte i followed by k zero bytes
+
+    constexpr Crc8Tables() : t() {
+        for (int i = 0; i < 256; ++i) {
+            uint8_t crc = static_cast<uint8_t>(i);
+            for (int j = 0; j < 8; ++j)
+                crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+            t[0][i] = crc;
+        }
+        for (int k = 1; k < 4; ++k)
+            for (int i = 0; i < 256; ++i)
+                t[k][i] = t[0][t[k - 1][i]];
+    }
+};
+
+struct Crc16Table {
+    uint16_t t[256];
+
+    constexpr Crc16Table() : t() {
+        for (int i = 0; i < 256; ++i) {
+            uint16_t crc = static_cast<uint16_t>(i << 8);
+            for (int j = 0; j < 8; ++j)
+                crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+            t[i] = crc;
+        }
+    }
+};
+
+struct Crc32Table {
+    uint32_t t[256];
+
+    constexpr Crc32Table() : t() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i << 24;
+            for (int j = 0; j < 8; ++j)
+                crc = (crc & 0x80000000UL) ? ((crc << 1) ^ 0x04C11DB7UL) : (crc << 1);
+            t[i] = crc;
+        }
+    }
+};
+
+static constexpr Crc8Tables crc8Tab{};
+static constexpr Crc16Table crc16Tab{};
+static constexpr Crc32Table crc32Tab{};
+
+uint8_t IspCrc::crc8Bitwise(const uint8_t* data, std::size_t len, uint8_t crc)
+{
+    for (std::size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int j = 0; j < 8; ++j) {
+            if (crc & 0x80)
+                crc = (crc << 1) ^ 0x07;
+            else
+                crc <<= 1;
+        }
+    }
+    return crc;
+}
+
+uint8_t IspCrc::crc8Table(const uint8_t* data, std::size_t len, uint8_t crc)
+{
+    const uint8_t* t = crc8Tab.t[0];
+    for (std::size_t i = 0; i < len; ++i)
+        crc = t[crc ^ data[i]];
+    return crc;
+}
+
+uint8_t IspCrc::crc8Slice4(const uint8_t* data, std::size_t len, uint8_t crc)
+{
+    const uint8_t (*t)[256] = crc8Tab.t;
+
+    // Four independent lookups per step instead of four dependent ones
+    while (len >= 4) {
+        crc = t[3][crc ^ data[0]] ^ t[2][data[1]] ^ t[1][data[2]] ^ t[0][data[3]];
+        data += 4;
+        len  -= 4;
+    }
+    while (len--)
+        crc = t[0][crc ^ *data++];
+    return crc;
+}
+
+uint16_t IspCrc::crc16(const uint8_t* data, std::size_t len, uint16_t crc)
+{
+    for (std::size_t i = 0; i < len; ++i)
+        crc = static_cast<uint16_t>((crc << 8) ^ crc16Tab.t[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+uint32_t IspCrc::crc32Table(const uint8_t* data, std::size_t len, uint32_t crc)
+{
+    for (std::size_t i = 0; i < len; ++i)
+        crc = (crc << 8) ^ crc32Tab.t[(crc >> 24) ^ data[i]];
+    return crc;
+}
+
+#ifdef ISP_CRC32_USE_HW
+uint32_t IspCrc::crc32Hw(const uint8_t* data, std::size_t len)
+{
+    if (!(RCC->AHB1ENR & RCC_AHB1ENR_CRCEN)) {
+        RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+        (void)RCC->AHB1ENR;
+    }
+
+    // Keep reset, feed and read-back atomic against any interrupt user
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    CRC->CR = CRC_CR_RESET;
+    std::size_t words = len / 4;
+    for (std::size_t i = 0; i < words; ++i, data += 4)
+        CRC->DR = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+    uint32_t crc = CRC->DR;
+
+    __set_PRIMASK(primask);
+
+    return crc32Table(data, len & 3, crc);
+}
+
+#endif
+
+#ifdef STM32F411xE
+// DWT is already running from timing_init()
+void IspCrc_Benchmark(IspCrcBenchResult& result)
+{
+    static uint8_t pattern[2048];
+    for (uint32_t i = 0; i < sizeof(pattern); i++)
+        pattern[i] = (uint8_t)(i * 7 + (i >> 8));
+
+    uint32_t start;
+    bool match = true;
+
+    start = DWT->CYCCNT;
+    uint8_t ref8 = IspCrc::crc8Bitwise(pattern, sizeof(pattern), 0x00);
+    result.crc8BitwiseCycles = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    match &= (IspCrc::crc8Table(pattern, sizeof(pattern), 0x00) == ref8);
+    result.crc8TableCycles = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    match &= (IspCrc::crc8Slice4(pattern, sizeof(pattern), 0x00) == ref8);
+    result.crc8Slice4Cycles = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    IspCrc::crc16(pattern, sizeof(pattern), 0xFFFF);
+    result.crc16Cycles = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    uint32_t ref32 = IspCrc::crc32Table(pattern, sizeof(pattern) - 3, 0xFFFFFFFFUL);
+    result.crc32TableCycles = DWT->CYCCNT - start;
+
+#ifdef ISP_CRC32_USE_HW
+    // Odd length so the software tail is exercised as well
+    start = DWT->CYCCNT;
+    match &= (IspCrc::crc32Hw(pattern, sizeof(pattern) - 3) == ref32);
+    result.crc32HwCycles = DWT->CYCCNT - start;
+#else
+    (void)ref32;
+    result.crc32HwCycles = 0;
+#endif
+
+    match &= (IspCrc::crc16((const uint8_t*)"123456789", 9, 0xFFFF) == 0x29B1);
+    match &= (IspCrc::crc32Table((const uint8_t*)"123456789", 9, 0xFFFFFFFFUL) == 0x0376E6E7UL);
+
+    result.bytes    = sizeof(pattern);
+    result.allMatch = match;
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Checksum engines behind IspFramingUtils.
+//
+// ISP_CRC8_ENGINE picks the CRC-8 implementation used for v1 frames at build
+// time; all three give identical results.  On target, CRC-32 frames use the
+// STM32F4 CRC unit (define ISP_CRC32_NO_HW to opt out), which computes
+// CRC-32/MPEG-2 over big-endian words; the table version covers the tail
+// bytes and host builds.
+#define ISP_CRC8_BITWISE   0
+#define ISP_CRC8_TABLE     1
+#define ISP_CRC8_SLICE4    2
+
+#ifndef ISP_CRC8_ENGINE
+#define ISP_CRC8_ENGINE    ISP_CRC8_SLICE4
+#endif
+
+#if defined(STM32F411xE) && !defined(ISP_CRC32_NO_HW)
+#define ISP_CRC32_USE_HW
+#endif
+
+class IspCrc {
+public:
+    // CRC-8 (polynomial 0x07, init 0x00)
+    static uint8_t crc8(const uint8_t* data, std::size_t len, uint8_t crc) {
+#if ISP_CRC8_ENGINE == ISP_CRC8_SLICE4
+        return crc8Slice4(data, len, crc);
+#elif ISP_CRC8_ENGINE == ISP_CRC8_TABLE
+        return crc8Table(data, len, crc);
+#else
+        return crc8Bitwise(data, len, crc);
+#endif
+    }
+
+    static uint8_t crc8Bitwise(const uint8_t* data, std::size_t len, uint8_t crc);
+    static uint8_t crc8Table(const uint8_t* data, std::size_t len, uint8_t crc);
+    static uint8_t crc8Slice4(const uint8_t* data, std::size_t len, uint8_t crc);
+
+    // CRC-16/CCITT-FALSE (polynomial 0x1021, init 0xFFFF)
+    static uint16_t crc16(const uint8_t* data, std::size_t len, uint16_t crc);
+
+    // CRC-32/MPEG-2 (polynomial 0x04C11DB7, init 0xFFFFFFFF, no reflection,
+    // no final XOR).  Not incremental when the hardware unit is used, so it
+    // must be given the whole payload at once.
+    static uint32_t crc32(const uint8_t* data, std::size_t len) {
+#ifdef ISP_CRC32_USE_HW
+        return crc32Hw(data, len);
+#else
+        return crc32Table(data, len, 0xFFFFFFFFUL);
+#endif
+    }
+
+    static uint32_t crc32Table(const uint8_t* data, std::size_t len, uint32_t crc);
+#ifdef ISP_CRC32_USE_HW
+    static uint32_t crc32Hw(const uint8_t* data, std::size_t len);
+#endif
+};
+
+#ifdef STM32F411xE
+// Checks every engine against the bitwise reference and measures the DWT
+// cycles each takes over the same buffer; reported by CRC_BENCHMARK.
+// crc32HwCycles is 0 when the hardware unit is not in use.
+struct IspCrcBenchResult {
+    uint32_t bytes;
+    uint32_t crc8BitwiseCycles;
+    uint32_t crc8TableCycles;
+    uint32_t crc8Slice4Cycles;
+    uint32_t crc16Cycles;
+    uint32_t crc32TableCycles;
+    uint32_t crc32HwCycles;
+    bool     allMatch;
+};
+
+void IspCrc_Benchmark(IspCrcBenchResult& result);
+#endif
@@ -0,0 +1,64 @@
+#include "IspFrameAssembler.h"
+#include <cstring>
+
+IspFrameAssembler::IspFrameAssembler() : fill(0), lastPushMs(0), handler(nullptr) {
+}
+
+void IspFrameAssembler::push(const uint8_t* data, std::size_t len, uint32_t nowMs)
+{
+    if (!data || !handler) return;
+
+    if (fill != 0 && (nowMs - lastPushMs) > PARTIAL_TIMEOUT_MS) {
+        fill = 0;
+    }
+    lastPushMs = nowMs;
+
+    while (len > 0)
+    {
+        if (fill == 0)
+        {
+            if (!IspFramingUtils::isStartByte(data[0])) {
+                // Not at a frame boundary - drop the rest of the packet
+                return;
+            }
+
+            // Whole frame inside this packet: no copy needed
+            std::size_t frameLen = IspFramingUtils::frameLength(data, len);
+            if (frameLen != 0 && frameLen <= len)
+            {
+                handler(data, frameLen);
+                data += frameLen;
+                len  -= frameLen;
+                continue;
+            }
+
+            // v1 frames never span packets; a short one is simply corrupt
+            if (data[0] == IspFramingUtils::START_BYTE) return;
+        }
+
+        // Take the length field first, then exactly the rest of the frame
+        std::size_t frameLen = IspFramingUtils::frameLength(frame, fill);
+        std::size_t want = (frameLen == 0) ? (3 - fill) : (frameLen - fill);
+        if (frameLen > MAX_FRAME) {
+            fill = 0;
+            return;
+        }
+
+        std::size_t take = (len < want) ? len : want;
+        memcpy(&frame[fill], data, take);
+        fill += take;
+        data += take;
+        len  -= take;
+
+        frameLen = IspFramingUtils::frameLength(frame, fill);
+        if (frameLen > MAX_FRAME) {
+            fill = 0;
+            return;
+        }
+        if (frameLen != 0 && fill == frameLen)
+        {
+            fill = 0;
+            handler(frame, frameLen);
+        }
+    }
+}
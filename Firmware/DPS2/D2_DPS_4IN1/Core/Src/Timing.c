@@ -0,0 +1,53 @@
+/**
+ ******************************************************************************
+ * @file    Timing.c
+ * @brief   DWT cycle counter delays and timeouts for the cartridge drivers
+ ******************************************************************************
+ * @attention
+ *
+ * Copyright (c) 2023-2024 ISquare Systems
+ * All rights reserved.
+ *
+ * This software is licensed under terms that can be found in the LICENSE file
+ * in the root directory of this software component.
+ * If no LICENSE file comes with this software, it is provided AS-IS.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "Timing.h"
+
+/**
+ * @brief  Start the DWT cycle counter every delay here runs on
+ * @note   Call once after SystemClock_Config(), before any driver runs.
+ */
+void timing_init(void)
+{
+    assert_param(SystemCoreClock == TIMING_SYSCLK_HZ);
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;  // enable DWT
+    DWT->CYCCNT       = 0;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;       // enable cycle counter
+}
+
+/**
+ * @brief  Microsecond delay, up to ~44 s at 96 MHz
+ * @note   Does not depend on SysTick, so it is safe in interrupt context.
+ */
+void delay_us(uint32_t us)
+{
+    delay_cycles(US_TO_CYCLES(us));
+}
+
+/**
+ * @brief  Millisecond delay
+ * @note   Does not depend on SysTick, so it is safe in interrupt context.
+ */
+void delay_ms(uint32_t ms)
+{
+    while (ms--)
+    {
+        delay_cycles(US_TO_CYCLES(1000U));
+    }
+}
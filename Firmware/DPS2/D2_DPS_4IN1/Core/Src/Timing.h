@@ -0,0 +1,95 @@
+/**
+ ******************************************************************************
+ * @file    Timing.h
+ * @brief   DWT cycle counter delays and timeouts for the cartridge drivers
+ ******************************************************************************
+ * @attention
+ *
+ * Copyright (c) 2023-2024 ISquare Systems
+ * All rights reserved.
+ *
+ * This software is licensed under terms that can be found in the LICENSE file
+ * in the root directory of this software component.
+ * If no LICENSE file comes with this software, it is provided AS-IS.
+ *
+ ******************************************************************************
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exported Constants --------------------------------------------------------*/
+/* Core clock set up by SystemClock_Config() (HSE 8 MHz, PLL /4 x192 /4).
+ * timing_init() checks it against SystemCoreClock. */
+#define TIMING_SYSCLK_HZ      96000000U
+#define TIMING_CYCLES_PER_US  (TIMING_SYSCLK_HZ / 1000000U)
+
+/* Datasheet times to core cycles, rounded up.  Constant arguments fold at
+ * compile time. */
+#define NS_TO_CYCLES(ns)  ((((uint32_t)(ns)) * TIMING_CYCLES_PER_US + 999U) / 1000U)
+#define US_TO_CYCLES(us)  (((uint32_t)(us)) * TIMING_CYCLES_PER_US)
+
+/* Exported Types ------------------------------------------------------------*/
+/**
+ * @brief Timeout for a polling loop, at most ~44 s at 96 MHz
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t cycles;
+} deadline_t;
+
+/* Exported Functions --------------------------------------------------------*/
+void timing_init(void);
+void delay_us(uint32_t us);
+void delay_ms(uint32_t ms);
+
+/**
+ * @brief  Busy-wait for a number of core cycles
+ * @note   Safe in interrupt context; the unsigned difference handles the
+ *         counter wrapping.
+ */
+__STATIC_FORCEINLINE void delay_cycles(uint32_t cycles)
+{
+    uint32_t start = DWT->CYCCNT;
+    while ((DWT->CYCCNT - start) < cycles);
+}
+
+/**
+ * @brief  Busy-wait for a bus timing given in nanoseconds
+ * @note   Pass a datasheet constant so the conversion folds; the call and
+ *         loop overhead only ever lengthen the wait.
+ */
+__STATIC_FORCEINLINE void delay_ns(uint32_t ns)
+{
+    delay_cycles(NS_TO_CYCLES(ns));
+}
+
+/**
+ * @brief  Start a timeout of the given length
+ */
+__STATIC_FORCEINLINE deadline_t deadline_us(uint32_t us)
+{
+    deadline_t d = { DWT->CYCCNT, US_TO_CYCLES(us) };
+    return d;
+}
+
+/**
+ * @brief  Check whether a timeout started with deadline_us() has run out
+ */
+__STATIC_FORCEINLINE uint8_t deadline_expired(const deadline_t* d)
+{
+    return (DWT->CYCCNT - d->start) >= d->cycles;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMING_H */
@@ -6,14 +6,14 @@
 #include <stdlib.h>
 #include "Protocol/safeBuffer.h"
 #include "Protocol/IspProtocolDefs.h"
+#include "Protocol/IspProgress.h"
 
 uint8_t GuiCtrlLed_SubCmdProcess::LED_CTRL_STATE = 0;
 
 Darin3::Darin3() : readerOpen_(false), writerOpen_(false), completeReadSize_(0)
 {
-    SetCartNo(CARTRIDGE_1);  // Default to cartridge 1
-    disk_initialize(0);
 	FatFsWrapper& fs = FatFsWrapper::getInstance();
+	fs.setCurrentCart(CARTRIDGE_1);  // Default to cartridge 1
 	if(fs.isMounted())
 	{
 		fs.unmount();
@@ -54,14 +54,21 @@ uint32_t Darin3::prepareForRx(const uint8_t* data,
     closeWriteStream();
     closeReadStream();
 
+    multiMask_ = 0;  // Only D3_WRITE_MULTI reports per-slot results
+
+    // data[0] = file-ID, data[1] = slot bitmask
+    if (subcmd == static_cast<uint8_t>(IspSubCommand::D3_WRITE_MULTI))
+    {
+        return prepareMulti(data[0], data[1] & 0x0F);
+    }
+
     // Otherwise data[0] = file‐ID, data[1] = cartNo
     uint8_t fileId = data[0];
     uint8_t cartID = data[1]-1;
     m_cartID = (CartridgeID)cartID;
-    SetCartNo(m_cartID);  // Set in diskio layer
 
     FatFsWrapper& fs = FatFsWrapper::getInstance();
-    fs.setCurrentCart(cartID);  // Track cartridge (no unmount yet)
+    fs.setCurrentCart(cartID);  // Select the slot's volume
     if (!fs.isMounted()) {
         fs.mount();  // Mount if needed
     }
@@ -84,6 +91,13 @@ uint32_t Darin3::prepareForRx(const uint8_t* data,
     return 0;
 }
 
+// File data goes out a sector at a time while the rest of a transfer is
+// still arriving; the write stream takes it in any split
+uint32_t Darin3::rxWriteStep(uint8_t subcmd)
+{
+    return 512;
+}
+
 uint8_t Darin3::processRxData(const uint8_t* data,
                               const uint8_t  subcmd,
                               uint32_t       len)
@@ -91,6 +105,10 @@ uint8_t Darin3::processRxData(const uint8_t* data,
     static uint32_t totalWritten = 0;  // Track total bytes written
     static uint32_t chunkCount = 0;    // Track number of chunks received
 
+    if (subcmd == static_cast<uint8_t>(IspSubCommand::D3_WRITE_MULTI)) {
+        return writeMulti(data, len);
+    }
+
     // If we never opened a writer, we can't write:
     if (!writerOpen_) {
         return 1;  // no active RX session
@@ -127,12 +145,96 @@ uint8_t Darin3::processRxData(const uint8_t* data,
     return 0;
 }
 
+FRESULT Darin3::selectCart(CartridgeID id)
+{
+    FatFsWrapper& fs = FatFsWrapper::getInstance();
+    fs.setCurrentCart(id);  // Each slot keeps its own mounted volume
+    if (!fs.isMounted()) {
+        return fs.mount();
+    }
+    return FR_OK;
+}
+
+// Create (or truncate) the file on every selected slot.  A slot that cannot
+// be mounted or written is marked failed and left out of the rest of the
+// transfer; the others carry on.
+uint32_t Darin3::prepareMulti(uint8_t fileId, uint8_t slotMask)
+{
+    multiFileId_ = fileId;
+    multiMask_   = slotMask;
+    multiOffset_ = 0;
+
+    FatFsWrapper& fs = FatFsWrapper::getInstance();
+    for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot) {
+        if (!(slotMask & (1U << slot))) {
+            multiResult_[slot] = static_cast<uint8_t>(IspReturnCodes::SUBCMD_NOTHANDLED);
+            continue;
+        }
+
+        FRESULT r = selectCart(static_cast<CartridgeID>(slot));
+        if (r == FR_OK) {
+            r = fs.createFile(fileId);
+        }
+        multiResult_[slot] = static_cast<uint8_t>(r == FR_OK ? IspReturnCodes::SUBCMD_SUCESS
+                                                            : IspReturnCodes::SUBCMD_FAILED);
+    }
+    return slotMask ? 0 : 1;
+}
+
+// Append one rxBuffer fill to the file on each slot still in the transfer.
+// Every slot stays mounted, so moving between them is only a drive change.
+uint8_t Darin3::writeMulti(const uint8_t* data, uint32_t len)
+{
+    // Every write closes its file, so the end-of-stream call has nothing to do
+    if (len == 0) {
+        return 0;
+    }
+
+    FatFsWrapper& fs = FatFsWrapper::getInstance();
+    uint8_t failed = 0;
+
+    for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot) {
+        if (multiResult_[slot] != static_cast<uint8_t>(IspReturnCodes::SUBCMD_SUCESS)) {
+            continue;
+        }
+
+        UINT written = 0;
+        FRESULT r = selectCart(static_cast<CartridgeID>(slot));
+        if (r == FR_OK) {
+            r = fs.writeFile(multiFileId_, data, static_cast<UINT>(len), written, multiOffset_);
+        }
+        if (r != FR_OK || written != len) {
+            multiResult_[slot] = static_cast<uint8_t>(IspReturnCodes::SUBCMD_FAILED);
+            failed = 1;
+        }
+    }
+
+    multiOffset_ += len;
+    return failed;
+}
+
+uint8_t Darin3::getSlotResults(uint8_t* codes)
+{
+    if (!multiMask_) {
+        return 0;
+    }
+
+    memcpy(codes, multiResult_, ISP_MAX_SLOTS);
+    multiMask_ = 0;  // Reported once, with the ACK_DONE of this transfer
+    return ISP_MAX_SLOTS;
+}
+
 uint8_t Darin3::prepareDataToTx(const uint8_t* data,
                                 const uint8_t  subcmd,
                                 uint32_t&      outLen)
 {
     uint32_t FileSize = 0;  // Declare at function scope
 
+    if (subcmd == static_cast<uint8_t>(IspSubCommand::D3_CART_COPY) ||
+        subcmd == static_cast<uint8_t>(IspSubCommand::D3_CART_COMPARE)) {
+        return cartCopy(data, subcmd, outLen);
+    }
+
     // If data is nullptr, this is a continuation call - just read next chunk
     if (data == nullptr) {
         // Continue reading from already open file
@@ -145,10 +247,8 @@ uint8_t Darin3::prepareDataToTx(const uint8_t* data,
         // Otherwise this is the initial call - extract parameters
         uint8_t msgId  = data[0];
         uint8_t cartNo = data[1] - 1;
-        SetCartNo(static_cast<CartridgeID>(cartNo));  // Set in diskio layer
-
         FatFsWrapper& fs = FatFsWrapper::getInstance();
-        fs.setCurrentCart(cartNo);  // Track cartridge (no unmount yet)
+        fs.setCurrentCart(cartNo);  // Select the slot's volume
         if (!fs.isMounted()) {
             fs.mount();  // Mount if needed
         }
@@ -223,6 +323,157 @@ uint8_t Darin3::prepareDataToTx(const uint8_t* data,
     return 0;    // success
 }
 
+// Cartridge to cartridge copy and compare, run entirely on the board.
+// data[0] = source slot (1-4), data[1] = destination slot mask,
+// data[2] = file ID, or 0 for every known file on the source.
+// Progress goes out as PROGRESS frames; the TX data is an IspCartReport.
+uint8_t Darin3::cartCopy(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen)
+{
+    outLen = 0;
+    if (data == nullptr || data[0] < 1 || data[0] > ISP_MAX_SLOTS) {
+        return 1;
+    }
+
+    closeWriteStream();
+    closeReadStream();
+
+    CartridgeID src = static_cast<CartridgeID>(data[0] - 1);
+    uint8_t dstMask = data[1] & 0x0F & ~(1U << src);
+    uint8_t fileId = data[2];
+
+    report_.begin(dstMask);
+
+    // The file set and its sizes come from the source
+    FatFsWrapper& fs = FatFsWrapper::getInstance();
+    FatFsWrapper::FileInfo files[MAX_SCANNED_FILES];
+    size_t fileCount = 0;
+    if (selectCart(src) != FR_OK || fs.scanFiles("/", files, MAX_SCANNED_FILES, fileCount) != FR_OK) {
+        report_.failSource();
+        fileCount = 0;
+    }
+
+    size_t kept = 0;
+    uint32_t total = 0;
+    for (size_t i = 0; i < fileCount; ++i) {
+        if (fileId == 0 || files[i].id == fileId) {
+            files[kept] = files[i];
+            total += files[kept].size;
+            kept++;
+        }
+    }
+    if (fileId != 0 && kept == 0) {
+        report_.failSource();  // Asked-for file is not on the source
+    }
+
+    IspProgress::begin(subcmd, total);
+
+    uint32_t done = 0;
+    for (size_t i = 0; i < kept && dstMask; ++i) {
+        if (subcmd == static_cast<uint8_t>(IspSubCommand::D3_CART_COPY)) {
+            copyFile(src, dstMask, files[i].id, files[i].size, done);
+        } else {
+            compareFile(src, dstMask, files[i].id, files[i].size, done);
+        }
+    }
+
+    IspProgress::finish();
+    outLen = report_.write();
+    return 0;
+}
+
+// The file is truncated on every destination, then copied in rxBuffer-sized
+// pieces.  Every slot stays mounted, so a piece costs no remounts.
+void Darin3::copyFile(CartridgeID src, uint8_t dstMask, int fileId, uint32_t size, uint32_t& done)
+{
+    FatFsWrapper& fs = FatFsWrapper::getInstance();
+
+    for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot) {
+        if (!(dstMask & (1U << slot)) || !report_.active(slot)) {
+            continue;
+        }
+        if (selectCart(static_cast<CartridgeID>(slot)) != FR_OK || fs.createFile(fileId) != FR_OK) {
+            report_.fail(slot);
+        }
+    }
+
+    for (uint32_t offset = 0; offset < size; ) {
+        UINT n = (size - offset > RX_BUFFER_SIZE) ? RX_BUFFER_SIZE : (UINT)(size - offset);
+        UINT read = 0;
+        if (selectCart(src) != FR_OK || fs.readFile(fileId, rxBuffer, n, read, offset) != FR_OK || read != n) {
+            report_.failSource();
+            return;
+        }
+
+        for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot) {
+            if (!(dstMask & (1U << slot)) || !report_.active(slot)) {
+                continue;
+            }
+            UINT written = 0;
+            if (selectCart(static_cast<CartridgeID>(slot)) != FR_OK ||
+                fs.writeFile(fileId, rxBuffer, n, written, offset) != FR_OK || written != n) {
+                report_.fail(slot);
+            }
+        }
+
+        offset += n;
+        done += n;
+        IspProgress::update(done);
+    }
+}
+
+// A destination whose file is missing, of another size or different in
+// content is listed once for the file.  rxBuffer holds the source piece in
+// one half and the destination piece in the other.
+void Darin3::compareFile(CartridgeID src, uint8_t dstMask, int fileId, uint32_t size, uint32_t& done)
+{
+    FatFsWrapper& fs = FatFsWrapper::getInstance();
+    uint8_t* expected = &rxBuffer[0];
+    uint8_t* actual = &rxBuffer[MAX_BUF_SIZE];
+    uint8_t live = 0;
+
+    for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot) {
+        if (!(dstMask & (1U << slot))) {
+            continue;
+        }
+        uint32_t dstSize = 0;
+        if (selectCart(static_cast<CartridgeID>(slot)) != FR_OK ||
+            fs.fileSize(fileId, dstSize) != FR_OK || dstSize != size) {
+            report_.mismatch(slot, fileId);
+        } else {
+            live |= (1U << slot);
+        }
+    }
+
+    uint32_t offset = 0;
+    while (offset < size && live) {
+        UINT n = (size - offset > MAX_BUF_SIZE) ? MAX_BUF_SIZE : (UINT)(size - offset);
+        UINT read = 0;
+        if (selectCart(src) != FR_OK || fs.readFile(fileId, expected, n, read, offset) != FR_OK || read != n) {
+            report_.failSource();
+            return;
+        }
+
+        for (int slot = 0; slot < ISP_MAX_SLOTS; ++slot) {
+            if (!(live & (1U << slot))) {
+                continue;
+            }
+            if (selectCart(static_cast<CartridgeID>(slot)) != FR_OK ||
+                fs.readFile(fileId, actual, n, read, offset) != FR_OK || read != n ||
+                memcmp(expected, actual, n) != 0) {
+                report_.mismatch(slot, fileId);
+                live &= ~(1U << slot);
+            }
+        }
+
+        offset += n;
+        done += n;
+        IspProgress::update(done);
+    }
+
+    // Nothing left to compare against: count the rest as done
+    done += size - offset;
+}
+
 void Darin3::TestDarinIIIFlash()
 {
 	uint8_t *data;
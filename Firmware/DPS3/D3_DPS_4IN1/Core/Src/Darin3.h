@@ -1,6 +1,10 @@
 #pragma once
 #include "Protocol/IIspSubCommandHandler.h"
+#include "Protocol/IspCrc.h"
+#include "Protocol/IspCommandManager.h"
+#include "Protocol/IspCartReport.h"
 #include "Darin3Cart_Driver.h"
+#include "Timing.h"
 #include "version.h"
 #include "stm32f4xx_hal.h"
 #include "main.h"
@@ -14,7 +18,9 @@ public:
 	~Darin3();  // Add destructor to ensure proper cleanup
 	uint32_t prepareForRx(const uint8_t* data, const uint8_t subcmd,uint32_t len) override;
 	uint8_t processRxData(const uint8_t* data, const uint8_t subcmd, uint32_t len) override;
+	uint32_t rxWriteStep(uint8_t subcmd) override;
     uint8_t prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen) override;
+    uint8_t getSlotResults(uint8_t* codes) override;
     void TestDarinIIIFlash();
     void TesFATfS();
 
@@ -23,6 +29,13 @@ public:
     void closeWriteStream();
 
 private:
+    FRESULT selectCart(CartridgeID id);
+    uint32_t prepareMulti(uint8_t fileId, uint8_t slotMask);
+    uint8_t writeMulti(const uint8_t* data, uint32_t len);
+    uint8_t cartCopy(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen);
+    void copyFile(CartridgeID src, uint8_t dstMask, int fileId, uint32_t size, uint32_t& done);
+    void compareFile(CartridgeID src, uint8_t dstMask, int fileId, uint32_t size, uint32_t& done);
+
     uint32_t storedLength = 0;
     #define Output 1
     #define Input  0
@@ -41,6 +54,16 @@ private:
 
     // Track file reading progress (was static variable - memory leak!)
     uint32_t completeReadSize_;
+
+    // D3_WRITE_MULTI: file being written, slots taking part (bit n =
+    // CARTRIDGE_1 + n), bytes written so far and per-slot IspReturnCodes
+    uint8_t  multiFileId_ = 0;
+    uint8_t  multiMask_ = 0;
+    uint32_t multiOffset_ = 0;
+    uint8_t  multiResult_[ISP_MAX_SLOTS];
+
+    // D3_CART_COPY / D3_CART_COMPARE result, sent back as the TX data
+    IspCartReport report_;
 };
 
 class Erase_SubCmdProcess : public IIspSubCommandHandler {
@@ -51,11 +74,9 @@ public:
 	{
 		DecodeCmdReq(reqData);
 		uint8_t cartId = rxBuffer[0]-1;  // Convert to 0-based
-		SetCartNo((CartridgeID)cartId);  // Set in diskio layer
-		disk_initialize(0);
 
 		FatFsWrapper& fs = FatFsWrapper::getInstance();
-		fs.setCurrentCart(cartId);  // Smart cart switching
+		fs.setCurrentCart(cartId);  // Select the slot's volume
 
 		// Always mount after setting cart (mount will handle initialization)
 		FRESULT mountRes = fs.mount();
@@ -94,6 +115,128 @@ public:
 	}
 };
 
+class LinkCaps_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	LinkCaps_SubCmdProcess() {}
+
+	// Advertises the large (v2) frame format; hosts that never ask keep
+	// talking v1 and are answered in v1
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		uint8_t data[6];
+		data[0] = ISP_FRAME_VERSION_LARGE;
+		data[1] = ISP_MAX_FRAME_PAYLOAD >> 8;
+		data[2] = ISP_MAX_FRAME_PAYLOAD & 0xFF;
+		data[3] = ISP_LARGE_CHUNK_SIZE >> 8;
+		data[4] = ISP_LARGE_CHUNK_SIZE & 0xFF;
+		data[5] = ISP_CRC_TYPE_CRC16_CCITT | ISP_CRC_TYPE_CRC32_MPEG2;
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::LINK_CAPS, &data[0] ,6);
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::LINK_CAPS;
+	}
+};
+
+class BusBenchmark_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	BusBenchmark_SubCmdProcess(){};
+
+	// Measures the data bus direction change on the device, for comparing
+	// firmware builds
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		uint32_t cycles = DataBus_TurnaroundCycles();
+		uint8_t data[4];
+		data[0] = (uint8_t)(cycles >> 24);
+		data[1] = (uint8_t)(cycles >> 16);
+		data[2] = (uint8_t)(cycles >> 8);
+		data[3] = (uint8_t)cycles;
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::BUS_BENCHMARK, &data[0] ,4);
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::BUS_BENCHMARK;
+	}
+};
+
+class CrcBenchmark_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	CrcBenchmark_SubCmdProcess(){};
+
+	// Checks every CRC engine against the bitwise reference and times them
+	// over the same buffer.  Answers [match][bytes 2B] and then the core
+	// cycles of crc8 bitwise, table, slice-by-4, crc16, crc32 table and
+	// crc32 hardware, 4 bytes big-endian each
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		IspCrcBenchResult bench;
+		IspCrc_Benchmark(bench);
+
+		const uint32_t cycles[6] = { bench.crc8BitwiseCycles, bench.crc8TableCycles, bench.crc8Slice4Cycles,
+		                             bench.crc16Cycles, bench.crc32TableCycles, bench.crc32HwCycles };
+		uint8_t data[3 + 6 * 4];
+		data[0] = bench.allMatch ? 1 : 0;
+		data[1] = (uint8_t)(bench.bytes >> 8);
+		data[2] = (uint8_t)bench.bytes;
+		for (int i = 0; i < 6; i++)
+		{
+			data[3 + 4 * i]     = (uint8_t)(cycles[i] >> 24);
+			data[3 + 4 * i + 1] = (uint8_t)(cycles[i] >> 16);
+			data[3 + 4 * i + 2] = (uint8_t)(cycles[i] >> 8);
+			data[3 + 4 * i + 3] = (uint8_t)cycles[i];
+		}
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::CRC_BENCHMARK, &data[0], sizeof(data));
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::CRC_BENCHMARK;
+	}
+};
+
+class DispatchBenchmark_SubCmdProcess : public IIspSubCommandHandler {
+public:
+	DispatchBenchmark_SubCmdProcess(IspCommandManager& mgr) : m_mgr(mgr) {};
+
+	// Times handleData() over frames that no handler takes, so only the
+	// dispatch lookups are counted.  Answers [frames 2B], then the core
+	// cycles for a CMD_REQ with an unregistered subcommand and for an
+	// unclaimed command byte, 4 bytes big-endian each
+	virtual uint16_t processCmdReq(uint8_t* reqData) override
+	{
+		DecodeCmdReq(reqData);
+		IspDispatchBenchResult bench;
+		IspDispatch_Benchmark(m_mgr, bench);
+
+		const uint32_t cycles[2] = { bench.controlCycles, bench.unclaimedCycles };
+		uint8_t data[2 + 2 * 4];
+		data[0] = (uint8_t)(bench.frames >> 8);
+		data[1] = (uint8_t)bench.frames;
+		for (int i = 0; i < 2; i++)
+		{
+			data[2 + 4 * i]     = (uint8_t)(cycles[i] >> 24);
+			data[2 + 4 * i + 1] = (uint8_t)(cycles[i] >> 16);
+			data[2 + 4 * i + 2] = (uint8_t)(cycles[i] >> 8);
+			data[2 + 4 * i + 3] = (uint8_t)cycles[i];
+		}
+		uint16_t len = EnocdeCmdRes((uint8_t)IspSubCommand::DISPATCH_BENCHMARK, &data[0], sizeof(data));
+		return len;
+	}
+	virtual IspSubCommand getSubCmd()override
+	{
+		return IspSubCommand::DISPATCH_BENCHMARK;
+	}
+
+private:
+	IspCommandManager& m_mgr;
+};
+
 class BoardID_SubCmdProcess : public IIspSubCommandHandler {
 public:
 	BoardID_SubCmdProcess() {}
@@ -120,7 +263,7 @@ public:
 	{
 		DecodeCmdReq(reqData);
         uint8_t packet[10];
-		UpdateD3SlotStatus();
+		FatFsWrapper::getInstance().releaseSlots(UpdateD3SlotStatus());
 		packet[0] = get_D3_slt_status(CARTRIDGE_1);
 		packet[1] = get_D3_slt_status(CARTRIDGE_2);
 		packet[2] = get_D3_slt_status(CARTRIDGE_3);
@@ -212,10 +355,9 @@ public:
 	{
 		DecodeCmdReq(reqData);
 		uint8_t cartId = rxBuffer[0]-1;  // Convert to 0-based
-		SetCartNo((CartridgeID)cartId);  // Set in diskio layer
 
 		FatFsWrapper& fs = FatFsWrapper::getInstance();
-		fs.setCurrentCart(cartId);  // Smart cart switching
+		fs.setCurrentCart(cartId);  // Select the slot's volume
 
 		// Always mount after setting cart (mount will handle initialization)
 		FRESULT mountRes = fs.mount();
@@ -312,17 +454,17 @@ public:
 	{
 		DecodeCmdReq(reqData);
 
+		// The cards come back reset (no SET MULTIPLE), so every slot is
+		// remounted and reinitialised, not just the current one
 		FatFsWrapper& fs = FatFsWrapper::getInstance();
-		fs.unmount();
+		fs.unmountAll();
 
 		// Power OFF.
-		// Use blocking_delay_ms (DWT-based) instead of HAL_Delay — HAL_Delay relies
+		// Use delay_ms (DWT-based) instead of HAL_Delay — HAL_Delay relies
 		// on the SysTick interrupt which cannot fire if we are already inside a
 		// higher-priority ISR (USB CDC receive), causing it to hang.
-		// short_delay_us(1000) was only ~320µs at 100MHz (loop calibrated as us*8 NOPs),
-		// which is insufficient for CF Vcc to discharge.
 		HAL_GPIO_WritePin(POWER_CYCLE_1_GPIO_Port, POWER_CYCLE_1_Pin, GPIO_PIN_RESET);
-		blocking_delay_ms(100);  // 100ms: Vcc discharges past CF POR threshold
+		delay_ms(100);  // 100ms: Vcc discharges past CF POR threshold
 
 		// Power ON.
 		HAL_GPIO_WritePin(POWER_CYCLE_1_GPIO_Port, POWER_CYCLE_1_Pin, GPIO_PIN_SET);
@@ -331,13 +473,13 @@ public:
 		// Root cause of FR_NOT_READY (~50% failure): previously 0ms here — disk_initialize
 		// fired immediately after GPIO_PIN_SET, racing the card's internal POR circuit.
 		// CF spec minimum: 50ms after Vcc stable. 500ms is safe for all CF card brands.
-		blocking_delay_ms(500);
+		delay_ms(500);
 
 		FRESULT res = fs.mount();
 
 		// One retry for cards that need slightly more settling time.
 		if (res != FR_OK) {
-			blocking_delay_ms(300);
+			delay_ms(300);
 			res = fs.mount();
 		}
 
@@ -10,6 +10,8 @@
 #include "stm32f4xx_ll_bus.h"
 #include "main.h"
 #include "Darin3Cart_Driver.h"
+#include "DataBus.h"
+#include "Timing.h"
 #include <stdlib.h>
 
 // Helper function to replace HAL_GPIO_WritePin
@@ -31,6 +33,9 @@ static inline uint8_t GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
     return LL_GPIO_IsInputPinSet(GPIOx, GPIO_Pin) ? 1 : 0;
 }
 
+/* LED blink half-period */
+#define LED_BLINK_MS  160U
+
 uint16_t CF_WE  = WE_Pin;
 uint16_t CF_RST = RESET_Pin;
 uint16_t CF_OE  = ATA_SEL_Pin;
@@ -84,95 +89,152 @@ uint16_t get_D3_slt_status(CartridgeID id) {
 
 void DataBus_SetOutput(void)
 {
-    // Ensure GPIOE clock is enabled
-    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOE);
-
-    // Configure each data bus pin as output using LL
-    LL_GPIO_SetPinMode(GPIOE, M_D0, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D0, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D0, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D0, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D1, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D1, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D1, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D1, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D2, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D2, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D2, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D2, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D3, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D3, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D3, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D3, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D4, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D4, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D4, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D4, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D5, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D5, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D5, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D5, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D6, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D6, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D6, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D6, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D7, LL_GPIO_MODE_OUTPUT);
-    LL_GPIO_SetPinOutputType(GPIOE, M_D7, LL_GPIO_OUTPUT_PUSHPULL);
-    LL_GPIO_SetPinSpeed(GPIOE, M_D7, LL_GPIO_SPEED_FREQ_LOW);
-    LL_GPIO_SetPinPull(GPIOE, M_D7, LL_GPIO_PULL_NO);
+    DataBus_DirOut();
 }
 
 void DataBus_SetInput(void)
 {
-    // Ensure GPIOE clock is enabled
-    LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_GPIOE);
-
-    // Configure each data bus pin as input using LL
-    LL_GPIO_SetPinMode(GPIOE, M_D0, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D0, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D1, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D1, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D2, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D2, LL_GPIO_PULL_NO);
-
-    LL_GPIO_SetPinMode(GPIOE, M_D3, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D3, LL_GPIO_PULL_NO);
+    DataBus_DirIn();
+}
 
-    LL_GPIO_SetPinMode(GPIOE, M_D4, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D4, LL_GPIO_PULL_NO);
+void DataBus_Configure(DataBusDirection direction)
+{
+    if(direction == DIR_OUTPUT)
+    {
+        DataBus_SetOutput();
+    }
+    else  // DIR_INPUT
+    {
+        DataBus_SetInput();
+    }
+}
 
-    LL_GPIO_SetPinMode(GPIOE, M_D5, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D5, LL_GPIO_PULL_NO);
+/**
+ * @brief  Core cycles for one output/input turnaround of the data bus
+ * @note   Best of 8 runs, so an interrupt landing in one does not count.
+ *         Leaves the bus an input; call only with every read strobe idle.
+ */
+uint32_t DataBus_TurnaroundCycles(void)
+{
+    uint32_t best = UINT32_MAX;
 
-    LL_GPIO_SetPinMode(GPIOE, M_D6, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D6, LL_GPIO_PULL_NO);
+    for (int run = 0; run < 8; run++)
+    {
+        uint32_t start = DWT->CYCCNT;
+        DataBus_DirOut();
+        DataBus_DirIn();
+        uint32_t cycles = DWT->CYCCNT - start;
+        if (cycles < best)
+            best = cycles;
+    }
+    return best;
+}
 
-    LL_GPIO_SetPinMode(GPIOE, M_D7, LL_GPIO_MODE_INPUT);
-    LL_GPIO_SetPinPull(GPIOE, M_D7, LL_GPIO_PULL_NO);
+//****************************************************************************
+// DATA REGISTER TRANSFER
+//****************************************************************************
+/* Strobes for the data loop, straight to BSRR: OE is PB15, WE is PD12 */
+#define CF_OE_LOW()   (ATA_SEL_GPIO_Port->BSRR = (uint32_t)ATA_SEL_Pin << 16)
+#define CF_OE_HIGH()  (ATA_SEL_GPIO_Port->BSRR = ATA_SEL_Pin)
+#define CF_WE_LOW()   (WE_GPIO_Port->BSRR = (uint32_t)WE_Pin << 16)
+#define CF_WE_HIGH()  (WE_GPIO_Port->BSRR = WE_Pin)
+
+/* 8-bit PIO cycle per mode in core cycles: strobe width t2, and recovery
+ * t0 - t2.  The strobe covers OE to data valid on reads and data setup to
+ * the WE rising edge on writes. */
+typedef struct {
+    uint16_t pw;
+    uint16_t rec;
+} CfPioTiming;
+
+static const CfPioTiming CF_PIO_TIMING[CF_PIO_MAX + 1] = {
+    { NS_TO_CYCLES(CF_tPW_NS), NS_TO_CYCLES(CF_tREC_NS) },  /* PIO0, 600 ns */
+    { NS_TO_CYCLES(290U),      NS_TO_CYCLES(93U)        },  /* PIO1, 383 ns */
+    { NS_TO_CYCLES(290U),      NS_TO_CYCLES(40U)        },  /* PIO2, 330 ns */
+    { NS_TO_CYCLES(80U),       NS_TO_CYCLES(100U)       },  /* PIO3, 180 ns */
+    { NS_TO_CYCLES(70U),       NS_TO_CYCLES(50U)        },  /* PIO4, 120 ns */
+};
+
+static inline const CfPioTiming* cf_pio_timing(uint8_t pio)
+{
+    if (pio > CF_PIO_MAX)
+        pio = CF_PIO_0;
+    else if (pio > CF_PIO_BOARD_MAX)
+        pio = CF_PIO_BOARD_MAX;
+    return &CF_PIO_TIMING[pio];
 }
 
-// DataBusDirection enum moved to header file
+__STATIC_FORCEINLINE uint8_t cf_read_cycle(uint32_t pw, uint32_t rec)
+{
+    CF_OE_LOW();
+    delay_cycles(pw);
+    uint8_t data = DataBus_In();
+    CF_OE_HIGH();
+    delay_cycles(rec);
+    return data;
+}
 
+__STATIC_FORCEINLINE void cf_write_cycle(uint8_t data, uint32_t pw, uint32_t rec)
+{
+    DataBus_Out(data);
+    CF_WE_LOW();
+    delay_cycles(pw);
+    CF_WE_HIGH();
+    delay_cycles(rec);
+}
 
-void DataBus_Configure(DataBusDirection direction)
+/**
+ * @brief  Read len bytes from the selected register at the given PIO mode
+ * @note   The caller has put the register on the address port and the bus
+ *         in input. Eight cycles per loop pass; one IDR load per byte.
+ */
+void CF_ReadData(uint8_t* buf, uint16_t len, uint8_t pio)
 {
-    if(direction == DIR_OUTPUT)
+    const CfPioTiming* t = cf_pio_timing(pio);
+    uint32_t pw  = t->pw;
+    uint32_t rec = t->rec;
+
+    for (uint16_t n = len / 8U; n; n--)
     {
-        DataBus_SetOutput();
+        buf[0] = cf_read_cycle(pw, rec);
+        buf[1] = cf_read_cycle(pw, rec);
+        buf[2] = cf_read_cycle(pw, rec);
+        buf[3] = cf_read_cycle(pw, rec);
+        buf[4] = cf_read_cycle(pw, rec);
+        buf[5] = cf_read_cycle(pw, rec);
+        buf[6] = cf_read_cycle(pw, rec);
+        buf[7] = cf_read_cycle(pw, rec);
+        buf += 8;
     }
-    else  // DIR_INPUT
+    for (len &= 7U; len; len--)
+        *buf++ = cf_read_cycle(pw, rec);
+}
+
+/**
+ * @brief  Write len bytes to the selected register at the given PIO mode
+ * @note   The caller has put the register on the address port and the bus
+ *         in output.
+ */
+void CF_WriteData(const uint8_t* buf, uint16_t len, uint8_t pio)
+{
+    const CfPioTiming* t = cf_pio_timing(pio);
+    uint32_t pw  = t->pw;
+    uint32_t rec = t->rec;
+
+    for (uint16_t n = len / 8U; n; n--)
     {
-        DataBus_SetInput();
+        cf_write_cycle(buf[0], pw, rec);
+        cf_write_cycle(buf[1], pw, rec);
+        cf_write_cycle(buf[2], pw, rec);
+        cf_write_cycle(buf[3], pw, rec);
+        cf_write_cycle(buf[4], pw, rec);
+        cf_write_cycle(buf[5], pw, rec);
+        cf_write_cycle(buf[6], pw, rec);
+        cf_write_cycle(buf[7], pw, rec);
+        buf += 8;
     }
+    for (len &= 7U; len; len--)
+        cf_write_cycle(*buf++, pw, rec);
 }
 
 //****************************************************************************
@@ -200,9 +262,9 @@ void pre_read_compact_flash(CartridgeID id)//function to pre intialise the ports
  GPIO_WritePin(GPIOB,CF_OE,1);				//disable output enable of compact flash
  GPIO_WritePin(GPIOD,get_CE_pin(id),0);
  GPIO_WritePin(GPIOD,CF_RST,1);				//Enable reset
- short_delay_us(50);
+ delay_us(50);
  GPIO_WritePin(GPIOD,CF_RST,0);				//disable reset
- short_delay_us(250);
+ delay_us(250);
 }
 //****************************************************************************
 //COMMAND_FOR _READ
@@ -212,58 +274,58 @@ void command_for_read(void)						 //function to intiate read command for compact
 	DataBus_Configure(DIR_OUTPUT);					 //set the mode of port p1 as output port
 
  write_address_port(sector_count); 				 //address the register pointer of CF to sector counter register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte( 0x01);								 //since single page is accessed at a time put value 0x01 into port p1
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);	         //intiate write so that that value 0x01 is stored in
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);			 //sector count register
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(sector_num);				 //address the register pointer of CF to sector number register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte( sector_number);  					 //send the sector number from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);			 //intiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(cyc_low);					 //address the register pointer of CF to cylinder low register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(Address_Flash_Page1);				 //send the cylinder low value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);			 //intiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(cyc_high);					 //address the register pointer of CF to cylinder high register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(Address_Flash_Page1  >> 8);			 //send the cylinder high value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);			 //intiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(drive);						 //address the register pointer of CF to drive register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(0xE0);								 //send the drive value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);			 //intiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(command);					 //address the register pointer of CF to comand register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(0x20);								 //send the command value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);			 //intiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(100);									 //longer delay after command
+ delay_us(100);									 //longer delay after command
  DataBus_Configure(DIR_INPUT);					 //set the mode of port p1 as input port
 }
 //****************************************************************************
@@ -272,19 +334,11 @@ void command_for_read(void)						 //function to intiate read command for compact
 void compact_flash_read(uint8_t *TempStorage,uint16_t datalength)
 {
  DataBus_Configure(DIR_INPUT);				 //ready to access data from the CF
- short_delay_us(5);                         // Allow bus direction to settle
+ delay_us(5);                         // Allow bus direction to settle
  write_address_port(data_reg) ;				 //address the register pointer to point to data regester
- short_delay_us(10);                        // Allow address to settle (increased delay)
+ delay_us(10);                        // Allow address to settle (increased delay)
 
- for (uint16_t x=0 ;x<datalength ;x++)		 //if data counter 'x'<512 then
- {
-  GPIO_WritePin(GPIOB, CF_OE, 0);		 //activate the output enable of CF
-  short_delay_us(2);                     // CF output enable setup time
-  *TempStorage = DataBus_ReadByte();				 //read the data from the CF and store it in address specified by 'pread'
-  GPIO_WritePin(GPIOB, CF_OE, 1);	     //disbale output enable of CF
-  short_delay_us(2);                     // CF output disable hold time
-  TempStorage++;							 //increment 'pread'
- }
+ CF_ReadData(TempStorage, datalength, CF_PIO_0);	 //read the data from the CF into TempStorage
 }
 //****************************************************************************
 //POST_READ_COMPACT_FLASH
@@ -323,9 +377,9 @@ void pre_write_compact_flash(CartridgeID id)              //this function initia
  GPIO_WritePin(GPIOB,CF_OE,1);				//disable output enable of compact flash
  GPIO_WritePin(GPIOD,get_CE_pin(id),0);
  GPIO_WritePin(GPIOD,CF_RST,1);				//Enable reset
- short_delay_us(50);
+ delay_us(50);
  GPIO_WritePin(GPIOD,CF_RST,0);				//disable reset
- short_delay_us(250);
+ delay_us(250);
 }
 //****************************************************************************
 //COMPACT_FLASH_READY
@@ -335,7 +389,7 @@ unsigned char compact_flash_ready(void)         //function to find wheather the
  unsigned char reg_status;
  DataBus_Configure(DIR_INPUT);               // Ensure data bus is input for reading status - MATCH ComprehensiveTest512
  write_address_port(status_reg);                //send 0x07 to CF so that select status register of CF - MATCH ComprehensiveTest512
- short_delay_us(10);			                        //MATCH ComprehensiveTest512 timing
+ delay_us(10);			                        //MATCH ComprehensiveTest512 timing
  GPIO_WritePin(GPIOB,CF_OE,0);                   // MATCH ComprehensiveTest512 - simple single read
  reg_status = DataBus_ReadByte();                // MATCH ComprehensiveTest512
  GPIO_WritePin(GPIOB,CF_OE,1);                   // MATCH ComprehensiveTest512
@@ -350,58 +404,58 @@ void command_for_write()	                    //this function is used to initiate
 	DataBus_Configure(DIR_OUTPUT);		                //set the mode of port p1 as output port
 
  write_address_port(sector_count); 				//address the register pointer of CF to sector counter register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(0x01);								//since single page is accessed at a time put value 0x01 into port p1
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);    		//initiate write so that that value 0x01 is stored in
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);    		//sector count register
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(sector_num);	    		//address the register pointer of CF to sector number register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(sector_number);			    		//send the sector number from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);    		//initiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(cyc_low);		    		//address the register pointer of CF to cylinder low register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(Address_Flash_Page1);				//send the cylinder low value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);    		//initiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(cyc_high);		    		//address the register pointer of CF to cylinder high register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(Address_Flash_Page1 >> 8);			//send the cylinder high value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);    		//initiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(drive);			    		//address the register pointer of CF to drive register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(0xE0);								//send the drive value from which you want to read the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);    		//initiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(10);
+ delay_ns(CF_tREC_NS);
 
  write_address_port(command);					//address the register pointer of CF to comand register
- short_delay_us(5);
+ delay_ns(CF_tAS_NS);
  DataBus_WriteByte(0x30);								//send the command value from which you want to WRITE the data
- short_delay_us(2);
+ delay_ns(CF_tDS_NS);
  GPIO_WritePin(GPIOD, CF_WE, 0);    		//initiate the write signal
- short_delay_us(5);
+ delay_ns(CF_tPW_NS);
  GPIO_WritePin(GPIOD, CF_WE, 1);
- short_delay_us(100);                     //longer delay after command
+ delay_us(100);                     //longer delay after command
  DataBus_Configure(DIR_INPUT);
 }
 //****************************************************************************
@@ -411,9 +465,9 @@ unsigned char check_stat_of_compact_flash(void)	//function to check wheather the
 {
  unsigned char reg_status;
  DataBus_Configure(DIR_INPUT);              // Ensure data bus is input for reading status
- short_delay_us(2);                         // Allow bus direction to settle
+ delay_us(2);                         // Allow bus direction to settle
  write_address_port(status_reg);				//address the register pointer to point to status regester
- short_delay_us(100);								    //wait for command to be processed - MATCH ComprehensiveTest512
+ delay_us(100);								    //wait for command to be processed - MATCH ComprehensiveTest512
  unsigned int BusyCnt;
 
  // Wait for not busy (bit 7 = 0) and data ready/DRQ (bit 3 = 1) - EXACTLY like ComprehensiveTest512
@@ -421,10 +475,10 @@ unsigned char check_stat_of_compact_flash(void)	//function to check wheather the
  do
  {
   GPIO_WritePin(GPIOB,CF_OE,0);
-  short_delay_us(2);                        // MATCH ComprehensiveTest512
+  delay_ns(CF_tPW_NS);                        // MATCH ComprehensiveTest512
   reg_status = DataBus_ReadByte();
   GPIO_WritePin(GPIOB,CF_OE,1);
-  short_delay_us(50);                       // MATCH ComprehensiveTest512 timing
+  delay_us(50);                       // MATCH ComprehensiveTest512 timing
   BusyCnt++;
  }while(((reg_status & 0x80) != 0 || (reg_status & 0x08) == 0) && (BusyCnt < 50000)); // MATCH ComprehensiveTest512 timeout
 
@@ -438,25 +492,16 @@ void compact_flash_write(uint8_t* TempStorage,uint16_t datalength)	//if command
  unsigned char busy;
  DataBus_Configure(DIR_OUTPUT);					//set the mode of port p1 as output port
  write_address_port(data_reg);				//address the register pointer to point to data regester
- short_delay_us(10);                       // Allow address to settle
- for (uint16_t x=0 ;x<datalength ;x++)      //if data counter value <last page size then
- {
-  DataBus_WriteByte(*TempStorage) ;			    //read the data from XRAM location load it into the CF
-  short_delay_us(1);                     // Setup time
-  GPIO_WritePin(GPIOD, CF_WE, 0);
-  short_delay_us(2);                     // WE pulse width
-  GPIO_WritePin(GPIOD, CF_WE, 1);	    //disable write signal of compact flash
-  short_delay_us(1);                     // Hold time
-  TempStorage++;					        //increment XRAM pointer
- }
+ delay_us(10);                       // Allow address to settle
+ CF_WriteData(TempStorage, datalength, CF_PIO_0);	//load the data from TempStorage into the CF
  DataBus_Configure(DIR_INPUT);
  write_address_port(status_reg);
- short_delay_us(100);                      // Allow time for write completion
+ delay_us(100);                      // Allow time for write completion
  GPIO_WritePin(GPIOB, CF_OE, 0);
  do                   	                    //check for error if one it means previous
  {						                    //command was ended with error
   busy = DataBus_ReadByte();
-  short_delay_us(10);                    // Delay between status reads
+  delay_us(10);                    // Delay between status reads
  }while((busy & 0x80) == 0x80);
  GPIO_WritePin(GPIOB, CF_OE, 1);
 }
@@ -559,14 +604,14 @@ void ComprehensiveTest512(CartridgeID id)
 	GPIO_WritePin(GPIOB, CF_OE, 1);        // Disable output enable
 	GPIO_WritePin(GPIOD, get_CE_pin(id), 0); // Enable chip select for this cartridge
 	GPIO_WritePin(GPIOD, CF_RST, 1);       // Enable reset
-	short_delay_us(100);
+	delay_us(100);
 	GPIO_WritePin(GPIOD, CF_RST, 0);       // Disable reset
-	short_delay_us(2000);  // Wait for CF to initialize
+	delay_ms(2);  // Wait for CF to initialize
 
 	// Check initial status
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(10);
+	delay_us(10);
 	GPIO_WritePin(GPIOB, CF_OE, 0);
 	volatile uint8_t initial_status = DataBus_ReadByte();
 	GPIO_WritePin(GPIOB, CF_OE, 1);
@@ -576,102 +621,102 @@ void ComprehensiveTest512(CartridgeID id)
 
 	// Set up write command for sector 0
 	write_address_port(sector_count);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x01);  // 1 sector
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(sector_num);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Sector 0
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_low);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder low
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_high);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder high
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(drive);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0xE0);  // Drive/head
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(command);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x30);  // Write sectors command
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(100);  // Wait for command acceptance
+	delay_us(100);  // Wait for command acceptance
 
 	// Wait for CF to be ready for data (DRQ = 1)
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(100);
+	delay_us(100);
 
 	volatile uint8_t write_status;
 	int timeout = 50000;
 	do {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		write_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(50);
+		delay_us(50);
 		timeout--;
 	} while (((write_status & 0x80) != 0 || (write_status & 0x08) == 0) && timeout > 0);
 
 	// Write all 512 bytes
 	DataBus_Configure(DIR_OUTPUT);
 	write_address_port(data_reg);
-	short_delay_us(10);
+	delay_us(10);
 
 	for (int i = 0; i < 512; i++) {
 		DataBus_WriteByte(write_data[i]);
-		short_delay_us(1);
+		delay_ns(CF_tDS_NS);
 		GPIO_WritePin(GPIOD, CF_WE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		GPIO_WritePin(GPIOD, CF_WE, 1);
-		short_delay_us(1);
+		delay_ns(CF_tREC_NS);
 	}
 
 	// Wait for write completion
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(1000);
+	delay_ms(1);
 
 	volatile uint8_t write_complete_status;
 	timeout = 100000;
 	do {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		write_complete_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(100);
+		delay_us(100);
 		timeout--;
 	} while ((write_complete_status & 0x80) != 0 && timeout > 0);
 
@@ -680,85 +725,85 @@ void ComprehensiveTest512(CartridgeID id)
 
 	// Set up read command for sector 0
 	write_address_port(sector_count);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x01);  // 1 sector
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(sector_num);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Sector 0
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_low);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder low
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_high);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder high
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(drive);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0xE0);  // Drive/head
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(command);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x20);  // Read sectors command
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(100);
+	delay_us(100);
 
 	// Wait for read command to complete and data ready
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(500);
+	delay_us(500);
 
 	volatile uint8_t read_status;
 	timeout = 50000;
 	do {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		read_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(50);
+		delay_us(50);
 		timeout--;
 	} while (((read_status & 0x80) != 0 || (read_status & 0x08) == 0) && timeout > 0);
 
 	// Read all 512 bytes
 	write_address_port(data_reg);
-	short_delay_us(10);
+	delay_us(10);
 
 	for (int i = 0; i < 512; i++) {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		read_data[i] = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(2);
+		delay_ns(CF_tREC_NS);
 	}
 
 	// Verify results - check key positions
@@ -808,14 +853,14 @@ void TesCompactFlashDriver(CartridgeID id)
 	write_compact_flash(&write_data[0], id);
 
 	// Small delay between write and read operations
-	short_delay_us(5000);  // 5ms delay to ensure write completion
+	delay_ms(5);  // 5ms delay to ensure write completion
 
 	// Check CF status after write before attempting read
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(10);
+	delay_us(10);
 	GPIO_WritePin(GPIOB, CF_OE, 0);
-	short_delay_us(2);
+	delay_ns(CF_tPW_NS);
 	volatile uint8_t status_after_write = DataBus_ReadByte();
 	GPIO_WritePin(GPIOB, CF_OE, 1);
 
@@ -825,9 +870,9 @@ void TesCompactFlashDriver(CartridgeID id)
 	// Check CF status after read
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(10);
+	delay_us(10);
 	GPIO_WritePin(GPIOB, CF_OE, 0);
-	short_delay_us(2);
+	delay_ns(CF_tPW_NS);
 	volatile uint8_t status_after_read = DataBus_ReadByte();
 	GPIO_WritePin(GPIOB, CF_OE, 1);
 
@@ -895,14 +940,14 @@ void SimpleReadTest(CartridgeID id)
 	GPIO_WritePin(GPIOB, CF_OE, 1);        // Disable output enable
 	GPIO_WritePin(GPIOD, get_CE_pin(id), 0); // Enable chip select for this cartridge
 	GPIO_WritePin(GPIOD, CF_RST, 1);       // Enable reset
-	short_delay_us(50);
+	delay_us(50);
 	GPIO_WritePin(GPIOD, CF_RST, 0);       // Disable reset
-	short_delay_us(1000);  // Wait longer for CF to initialize
+	delay_ms(1);  // Wait longer for CF to initialize
 
 	// Check if CF is ready before doing anything
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(10);
+	delay_us(10);
 	GPIO_WritePin(GPIOB, CF_OE, 0);
 	volatile uint8_t initial_status = DataBus_ReadByte();
 	GPIO_WritePin(GPIOB, CF_OE, 1);
@@ -910,7 +955,7 @@ void SimpleReadTest(CartridgeID id)
 	// Wait for CF to be ready (bit 7 = 0, bit 6 = 1)
 	int timeout = 10000;
 	while (((initial_status & 0x80) != 0 || (initial_status & 0x40) == 0) && timeout > 0) {
-		short_delay_us(10);
+		delay_us(10);
 		GPIO_WritePin(GPIOB, CF_OE, 0);
 		initial_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
@@ -922,72 +967,72 @@ void SimpleReadTest(CartridgeID id)
 
 	// Set up write command manually for sector 0
 	write_address_port(sector_count);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x01);  // 1 sector
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(sector_num);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Sector 0
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_low);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder low
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_high);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder high
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(drive);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0xE0);  // Drive/head
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(command);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x30);  // Write sectors command
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(50);  // Longer delay after command
+	delay_us(50);  // Longer delay after command
 
 	// Wait for CF to accept the write command and be ready for data
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(100);  // Longer delay for command to be processed
+	delay_us(100);  // Longer delay for command to be processed
 
 	volatile uint8_t write_status;
 	timeout = 50000;  // Increased timeout
 	do {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		write_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(50);  // Longer delay between status checks
+		delay_us(50);  // Longer delay between status checks
 		timeout--;
 	} while (((write_status & 0x80) != 0 || (write_status & 0x08) == 0) && timeout > 0);  // Wait for not busy and DRQ
 
@@ -995,39 +1040,39 @@ void SimpleReadTest(CartridgeID id)
 
 	// Write 10 test bytes
 	write_address_port(data_reg);
-	short_delay_us(10);  // Allow address to settle
+	delay_us(10);  // Allow address to settle
 	for (int i = 0; i < 10; i++) {
 		DataBus_WriteByte(i + 0x41);  // Write 'A', 'B', 'C', etc.
-		short_delay_us(2);  // Setup time
+		delay_ns(CF_tDS_NS);  // Setup time
 		GPIO_WritePin(GPIOD, CF_WE, 0);
-		short_delay_us(5);  // WE pulse width
+		delay_ns(CF_tPW_NS);  // WE pulse width
 		GPIO_WritePin(GPIOD, CF_WE, 1);
-		short_delay_us(2);  // Hold time
+		delay_ns(CF_tREC_NS);  // Hold time
 	}
 
 	// Fill rest of sector with 0xFF
 	for (int i = 10; i < 512; i++) {
 		DataBus_WriteByte(0xFF);
-		short_delay_us(1);  // Setup time
+		delay_ns(CF_tDS_NS);  // Setup time
 		GPIO_WritePin(GPIOD, CF_WE, 0);
-		short_delay_us(2);  // WE pulse width
+		delay_ns(CF_tPW_NS);  // WE pulse width
 		GPIO_WritePin(GPIOD, CF_WE, 1);
-		short_delay_us(1);  // Hold time
+		delay_ns(CF_tREC_NS);  // Hold time
 	}
 
 	// Wait for write to complete - check status
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(1000);  // Give more time for write to complete
+	delay_ms(1);  // Give more time for write to complete
 
 	volatile uint8_t write_complete_status;
 	timeout = 100000;  // Much longer timeout for write completion
 	do {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		write_complete_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(100);  // Longer delay between checks
+		delay_us(100);  // Longer delay between checks
 		timeout--;
 	} while ((write_complete_status & 0x80) != 0 && timeout > 0);  // Wait for not busy
 
@@ -1035,92 +1080,92 @@ void SimpleReadTest(CartridgeID id)
 	DataBus_Configure(DIR_OUTPUT);
 
 	write_address_port(sector_count);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x01);  // 1 sector
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(sector_num);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Sector 0
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_low);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder low
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(cyc_high);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x00);  // Cylinder high
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(drive);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0xE0);  // Drive/head
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(10);
+	delay_ns(CF_tREC_NS);
 
 	write_address_port(command);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	DataBus_WriteByte(0x20);  // Read sectors command
-	short_delay_us(2);
+	delay_ns(CF_tDS_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 0);
-	short_delay_us(5);
+	delay_ns(CF_tPW_NS);
 	GPIO_WritePin(GPIOD, CF_WE, 1);
-	short_delay_us(50);  // Longer delay after command
+	delay_us(50);  // Longer delay after command
 
 	// Wait for read command to complete and data to be ready
 	DataBus_Configure(DIR_INPUT);
 	write_address_port(status_reg);
-	short_delay_us(500);  // Allow time for read command to be processed
+	delay_us(500);  // Allow time for read command to be processed
 
 	volatile uint8_t read_status;
 	timeout = 50000;  // Increased timeout for read
 	do {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		read_status = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(50);  // Longer delay between status checks
+		delay_us(50);  // Longer delay between status checks
 		timeout--;
 	} while (((read_status & 0x80) != 0 || (read_status & 0x08) == 0) && timeout > 0);  // Wait for not busy and DRQ
 
 	// Check status
 	write_address_port(status_reg);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 	GPIO_WritePin(GPIOB, CF_OE, 0);
 	volatile uint8_t status_after_read_cmd = DataBus_ReadByte();
 	GPIO_WritePin(GPIOB, CF_OE, 1);
 
 	// Now read the data
 	write_address_port(data_reg);
-	short_delay_us(5);
+	delay_ns(CF_tAS_NS);
 
 	for (int i = 0; i < 10; i++) {
 		GPIO_WritePin(GPIOB, CF_OE, 0);
-		short_delay_us(2);
+		delay_ns(CF_tPW_NS);
 		test_data[i] = DataBus_ReadByte();
 		GPIO_WritePin(GPIOB, CF_OE, 1);
-		short_delay_us(2);
+		delay_ns(CF_tREC_NS);
 	}
 
 	// Check our results
@@ -1132,14 +1177,11 @@ void SimpleReadTest(CartridgeID id)
 
 #endif  /* TEST FUNCTIONS */
 
-// Write with setup/hold time
+// Write with setup time
 void DataBus_WriteByte(uint8_t data)
 {
-    // Set data on bus with proper setup time
-    GPIOE->BSRR = (0xFF << 16) | data;
-
-    // Setup time delay - CompactFlash typically needs 30ns minimum
-    short_delay_us(1);  // 1 microsecond should be plenty
+    DataBus_Out(data);
+    delay_ns(CF_tDS_NS);  // data setup before the strobe edge
 }
 
 // Read with proper timing
@@ -1147,30 +1189,31 @@ uint8_t DataBus_ReadByte(void)
 {
     uint8_t data;
 
-    // Access time delay - CompactFlash typically needs 50-100ns
-    short_delay_us(1);  // 1 microsecond for safety
+    // OE to data valid is covered by the caller's strobe width; this only
+    // lets the bus settle after a direction change
+    delay_ns(CF_tDS_NS);
 
     // Read data twice for stability (in case of bus capacitance)
-    data = (uint8_t)(GPIOE->IDR & 0xFF);
-    short_delay_us(1);
-    data = (uint8_t)(GPIOE->IDR & 0xFF);
+    data = DataBus_In();
+    delay_ns(CF_tDS_NS);
+    data = DataBus_In();
 
     return data;
 }
 
-void UpdateD3SlotStatus()
+// Read the card detect pins; returns a bit per slot whose card was removed
+// or inserted since the last call
+uint8_t UpdateD3SlotStatus()
 {
+	uint8_t changed = 0;
 	for(int itr=0;itr<4;itr++)
 	{
-		if( 0 == GPIO_ReadPin(GPIOC, CD2_SLT[itr]))
-		{
-			SLT_STATUS[itr] = 0x03;
-		}
-		else
-		{
-			SLT_STATUS[itr] = 0x00;
-		}
+		uint8_t status = (0 == GPIO_ReadPin(GPIOC, CD2_SLT[itr])) ? 0x03 : 0x00;
+		if (status != SLT_STATUS[itr])
+			changed |= (uint8_t)(1U << itr);
+		SLT_STATUS[itr] = status;
 	}
+	return changed;
 }
 
 uint16_t get_D3_Green_LedPins(CartridgeID id) {
@@ -1196,23 +1239,6 @@ void setRedLed(CartridgeID id, uint8_t value)
 		GPIO_WritePin(GPIOA, get_D3_Red_LedPins(id), 0);
 }
 
-void short_delay_us(uint32_t us) {
-    for (volatile uint32_t i = 0; i < us * 8; i++) {
-        __NOP();  // One NOP ~1 cycle
-    }
-}
-
-// Interrupt-safe blocking delay using the DWT cycle counter.
-// Unlike HAL_Delay, this does not depend on the SysTick interrupt, so it works
-// correctly when called from inside an ISR (e.g. USB CDC receive callback).
-void blocking_delay_ms(uint32_t ms) {
-    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;  // enable DWT
-    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;       // enable cycle counter
-    uint32_t start  = DWT->CYCCNT;
-    uint32_t ticks  = ms * (SystemCoreClock / 1000UL);
-    while ((DWT->CYCCNT - start) < ticks);  // unsigned wrap handles rollover
-}
-
 void slotLedBlink(CartridgeID id, uint8_t value)
 {
     uint16_t red_pin = get_D3_Red_LedPins(id);
@@ -1222,10 +1248,10 @@ void slotLedBlink(CartridgeID id, uint8_t value)
     {
         GPIOA->BSRR = red_pin;                      // Set red LED
         GPIOA->BSRR = green_pin;                    // Set green LED
-        short_delay_us(500000);
+        delay_ms(LED_BLINK_MS);
         GPIOA->BSRR = (red_pin << 16);              // Reset red LED
         GPIOA->BSRR = (green_pin << 16);            // Reset green LED
-        short_delay_us(500000);
+        delay_ms(LED_BLINK_MS);
         --value;
     }
 }
@@ -1246,10 +1272,10 @@ uint8_t LedLoopBack(uint8_t value)
         if(GPIOB->IDR & LB4_Pin)
             data = data | 0x08;
 
-        short_delay_us(500000);
+        delay_ms(LED_BLINK_MS);
 
         GPIOA->ODR = (GPIOA->ODR & 0x1FE00U) | 0x00;
-        short_delay_us(500000);
+        delay_ms(LED_BLINK_MS);
 
         if(GPIOB->IDR & LB1_Pin)
             data2 = data2 | 0x01;
@@ -1274,11 +1300,11 @@ void BlinkAllLed(uint8_t value)
 	{
 		// Toggle PA1-PA8
 		GPIOA->ODR ^= 0x1FE;  // 0x1FE = bits 1-8
-		short_delay_us(500000);
+		delay_ms(LED_BLINK_MS);
 
 		// Toggle again to return to original state
 		GPIOA->ODR ^= 0x1FE;
-		short_delay_us(500000);
+		delay_ms(LED_BLINK_MS);
 	}
 }
 
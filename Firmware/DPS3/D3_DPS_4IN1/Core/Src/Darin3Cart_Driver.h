@@ -26,6 +26,23 @@ typedef enum {
     DIR_OUTPUT = 1
 } DataBusDirection;
 
+/* CF register access timing, PIO mode 0 (minimum) */
+#define CF_tAS_NS    70U     /* Address valid to WE/OE low */
+#define CF_tDS_NS    60U     /* Data setup to WE high */
+#define CF_tPW_NS    290U    /* WE/OE pulse width, also covers OE to data valid */
+#define CF_tREC_NS   310U    /* Strobe recovery, completes the 600 ns cycle */
+
+/* PIO modes for CF_ReadData/CF_WriteData; a card lists the ones it supports
+ * in IDENTIFY DEVICE.  Anything above CF_PIO_MAX runs at PIO0. */
+#define CF_PIO_0     0U
+#define CF_PIO_MAX   4U
+
+/* Fastest mode this board runs.  OE, WE and the data pads are left at
+ * GPIO_SPEED_FREQ_LOW, whose ~100 ns edges are longer than the PIO3/4
+ * strobes, and IORDY is not wired.  PIO3/4 run as PIO2 until they have been
+ * measured on the board. */
+#define CF_PIO_BOARD_MAX  2U
+
 void read_compact_flash(uint8_t *TempStorage, CartridgeID id);
 void pre_read_compact_flash(CartridgeID id);
 void command_for_read(void);
@@ -48,10 +65,13 @@ void ComprehensiveTest512(CartridgeID id);
 void DataBus_Configure(DataBusDirection direction);
 void DataBus_SetOutput(void);
 void DataBus_SetInput(void);
+uint32_t DataBus_TurnaroundCycles(void);
 void DataBus_WriteByte(uint8_t data);
 uint8_t DataBus_ReadByte(void);
+void CF_ReadData(uint8_t* buf, uint16_t len, uint8_t pio);
+void CF_WriteData(const uint8_t* buf, uint16_t len, uint8_t pio);
 
-void UpdateD3SlotStatus(void);
+uint8_t UpdateD3SlotStatus(void);
 
 uint16_t get_CE_pin(CartridgeID id);
 uint16_t get_D3_Green_LedPins(CartridgeID id);
@@ -60,8 +80,6 @@ uint16_t get_CD2SLT_pin(CartridgeID id);
 uint16_t get_D3_slt_status(CartridgeID id);
 void setGreenLed(CartridgeID id, uint8_t value);
 void setRedLed(CartridgeID id, uint8_t value);
-void short_delay_us(uint32_t us);
-void blocking_delay_ms(uint32_t ms);
 void slotLedBlink(CartridgeID id, uint8_t value);
 uint8_t LedLoopBack(uint8_t value);
 void BlinkAllLed(uint8_t value);
@@ -57,37 +57,67 @@ const char* FatFsWrapper::getFilenameById(int id) const {
     return nullptr;
 }
 
+const TCHAR* FatFsWrapper::drivePath(int cartId) {
+    static const TCHAR* const kDrivePaths[FF_VOLUMES] = { "0:", "1:", "2:", "3:" };
+    return kDrivePaths[cartId];
+}
+
 FRESULT FatFsWrapper::mount() {
+    const int slot = currentCartId_;
+
     // If already mounted, unmount first
-    if (mounted_) {
-        f_mount(nullptr, "", 0);
-        mounted_ = false;
+    if (mounted_[slot]) {
+        f_mount(nullptr, drivePath(slot), 0);
+        mounted_[slot] = false;
     }
 
     // Now mount
-    FRESULT r = f_mount(&internalFs_, "", 1);
-    mounted_ = (r == FR_OK);
+    FRESULT r = f_mount(&internalFs_[slot], drivePath(slot), 1);
+    mounted_[slot] = (r == FR_OK);
     return r;
 }
 
 FRESULT FatFsWrapper::unmount() {
-    if (mounted_) {
-        FRESULT r = f_mount(nullptr, "", 0);
-        mounted_ = false;
+    const int slot = currentCartId_;
+
+    if (mounted_[slot]) {
+        FRESULT r = f_mount(nullptr, drivePath(slot), 0);
+        mounted_[slot] = false;
         return r;
     }
     return FR_OK;
 }
 
+void FatFsWrapper::unmountAll() {
+    for (int slot = 0; slot < FF_VOLUMES; ++slot) {
+        if (mounted_[slot]) {
+            f_mount(nullptr, drivePath(slot), 0);
+            mounted_[slot] = false;
+        }
+    }
+}
+
 void FatFsWrapper::forceCartridgeReinit(CartridgeID id) {
     // Force complete disk reinitialization for cartridge switching
     ForceCartridgeReinit(id);
 }
 
+void FatFsWrapper::releaseSlots(uint8_t mask) {
+    for (int slot = 0; slot < FF_VOLUMES; ++slot) {
+        if (!(mask & (1U << slot)))
+            continue;
+        if (mounted_[slot]) {
+            f_mount(nullptr, drivePath(slot), 0);
+            mounted_[slot] = false;
+        }
+        InvalidateCartridge(static_cast<CartridgeID>(slot));
+    }
+}
+
 FRESULT FatFsWrapper::createFile(int id, BYTE mode) {
     const char* filename = getFilenameById(id);
     if (!filename) return FR_NO_FILE;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     FIL f;
     FRESULT r = f_open(&f, filename, mode);
@@ -98,7 +128,7 @@ FRESULT FatFsWrapper::createFile(int id, BYTE mode) {
 FRESULT FatFsWrapper::deleteFile(int id) {
     const char* filename = getFilenameById(id);
     if (!filename) return FR_NO_FILE;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     return f_unlink(filename);
 }
@@ -106,7 +136,7 @@ FRESULT FatFsWrapper::deleteFile(int id) {
 FRESULT FatFsWrapper::fileSize(int id, uint32_t& size) {
     const char* filename = getFilenameById(id);
     if (!filename) return FR_NO_FILE;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     FILINFO fi;
     FRESULT r = f_stat(filename, &fi);
@@ -118,7 +148,7 @@ FRESULT FatFsWrapper::writeFile(int id, const void* data, UINT bytesToWrite, UIN
     if (!data && bytesToWrite > 0) return FR_INVALID_PARAMETER;
     const char* filename = getFilenameById(id);
     if (!filename) return FR_NO_FILE;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     FIL f;
     FRESULT r = f_open(&f, filename, FA_WRITE | FA_OPEN_ALWAYS);
@@ -135,7 +165,7 @@ FRESULT FatFsWrapper::readFile(int id, void* buffer, UINT bytesToRead, UINT& byt
     if (!buffer && bytesToRead > 0) return FR_INVALID_PARAMETER;
     const char* filename = getFilenameById(id);
     if (!filename) return FR_NO_FILE;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     FIL f;
     FRESULT r = f_open(&f, filename, FA_READ);
@@ -150,7 +180,7 @@ FRESULT FatFsWrapper::readFile(int id, void* buffer, UINT bytesToRead, UINT& byt
 
 FRESULT FatFsWrapper::deleteAllFiles(const char* dirPath) {
     if (!dirPath) return FR_INVALID_PARAMETER;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     DIR dir;
     FILINFO fno;
@@ -183,7 +213,7 @@ FRESULT FatFsWrapper::deleteAllFiles(const char* dirPath) {
 FRESULT FatFsWrapper::scanFiles(const char* dirPath, FileInfo* outFiles, size_t maxFiles, size_t& fileCount) {
     fileCount = 0;
     if (!dirPath || !outFiles) return FR_INVALID_PARAMETER;
-    if (!mounted_ && mount() != FR_OK) return FR_NOT_READY;
+    if (!isMounted() && mount() != FR_OK) return FR_NOT_READY;
 
     DIR dir;
     FILINFO fno;
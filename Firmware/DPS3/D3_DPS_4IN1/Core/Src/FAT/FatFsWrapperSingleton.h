@@ -39,15 +39,13 @@ public:
         return instance;
     }
     
-    // Smart cartridge switching with automatic unmount and disk reinitialization
+    // Select the slot later calls work on. Each slot stays mounted as its own
+    // volume ("0:".."3:"), so switching only changes the FatFs default drive.
     void setCurrentCart(int cartId) {
+        if (cartId < 0 || cartId >= FF_VOLUMES) return;
         if (cartId != currentCartId_) {
-            if (mounted_) {
-                unmount();  // Unmount if switching carts while mounted
-            }
             currentCartId_ = cartId;
-            // Force disk reinitialization for the new cartridge
-            forceCartridgeReinit((CartridgeID)cartId);
+            f_chdrive(drivePath(cartId));
         }
     }
     
@@ -57,10 +55,13 @@ public:
     FatFsWrapper(const FatFsWrapper&) = delete;
     FatFsWrapper& operator=(const FatFsWrapper&) = delete;
 
-    // Basic operations
+    // Basic operations, on the current slot
     FRESULT mount();
     FRESULT unmount();
-    bool isMounted() const { return mounted_; }
+    bool isMounted() const { return mounted_[currentCartId_]; }
+
+    // Every slot, e.g. before a power cycle resets the cards
+    void unmountAll();
 
     // File operations by ID
     FRESULT createFile(int id, BYTE mode = FA_WRITE | FA_CREATE_ALWAYS);
@@ -82,6 +83,10 @@ public:
     
     // Cartridge reinitialization helper
     void forceCartridgeReinit(CartridgeID id);
+
+    // Drop the volume and card setup of each slot in mask (bit n = slot n),
+    // for slots whose card was removed or swapped
+    void releaseSlots(uint8_t mask);
     
     // Format
     FRESULT format(const TCHAR* path = "", BYTE fmt = FM_ANY, UINT au = 0);
@@ -128,12 +133,14 @@ public:
     }
 
 private:
-    FatFsWrapper() : mounted_(false), currentCartId_(-1) {}
-    ~FatFsWrapper() { unmount(); }
+    FatFsWrapper() : mounted_(), currentCartId_(0) {}
+    ~FatFsWrapper() { unmountAll(); }
+
+    static const TCHAR* drivePath(int cartId);
 
-    FATFS internalFs_;
-    bool mounted_;
-    int currentCartId_;  // Track current cartridge (-1 = none)
+    FATFS internalFs_[FF_VOLUMES];  // One mounted volume per slot
+    bool mounted_[FF_VOLUMES];
+    int currentCartId_;             // Slot of the FatFs default drive
     
     // Helper to get filename by ID
     const char* getFilenameById(int id) const;
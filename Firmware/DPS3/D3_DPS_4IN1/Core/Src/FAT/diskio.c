@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../Darin3Cart_Driver.h"
+#include "../Timing.h"
 
 // ===== DIRECT CF IMPLEMENTATION - USE EXISTING SYMBOLS FROM WORKING DRIVER =====
 
@@ -31,21 +32,53 @@ extern uint16_t CF_CE[4];
 #define command        0x07
 #define status_reg     0x07
 
+// ATA commands
+#define ATA_READ_SECTORS    0x20
+#define ATA_WRITE_SECTORS   0x30
+#define ATA_READ_MULTIPLE   0xC4
+#define ATA_WRITE_MULTIPLE  0xC5
+#define ATA_SET_MULTIPLE    0xC6
+#define ATA_IDENTIFY        0xEC
+
+// Status register bits
+#define ST_BSY  0x80
+#define ST_RDY  0x40
+#define ST_DF   0x20
+#define ST_DRQ  0x08
+#define ST_ERR  0x01
+
+#define CF_SECTOR_SIZE      512U
+#define CF_MULTIPLE_MAX     16U         // Largest DRQ block offered to a card IDENTIFY gave no limit for
+#define CF_DEFAULT_SECTORS  262144UL    // 128 MB: every card in use is at least this, if IDENTIFY fails
+#define CF_PIO_LIMIT        CF_PIO_BOARD_MAX  // No IORDY, low-speed pads: IDENTIFY never selects more than this
+#define CF_DRQ_TIMEOUT_US   200000U     // Per DRQ block; stuck sectors must stay well under the 20s ISP timeout
+#define CF_DONE_TIMEOUT_US  500000U     // Write completion after the last block
+#define CF_tSTATUS_NS       400U        // Command/data end to valid status (ATA)
+
 // FatFs disk control constants
 #define CTRL_SYNC       0
 #define GET_SECTOR_COUNT    1
 #define GET_SECTOR_SIZE     2
 #define GET_BLOCK_SIZE      3
 
-CartridgeID m_CartId = CARTRIDGE_1;  // Current cartridge
-static int disk_initialized = 0;  // Track if disk is initialized
-static CartridgeID last_initialized_cart = (CartridgeID)-1;  // Track last initialized cart
+// FatFs physical drive n is cartridge slot n; each slot keeps its own state
+#define CF_SLOTS            4U
+
+// What IDENTIFY DEVICE reported for each slot, and the transfer settings chosen from it
+typedef struct {
+    uint8_t ready;          // disk_initialize succeeded and nothing has invalidated it since
+    DWORD   sectors;        // Words 60-61, LBA addressable sectors; 0 if the card did not answer
+    uint8_t maxMultiple;    // Word 47, largest DRQ block for READ/WRITE MULTIPLE
+    uint8_t multiple;       // DRQ block set with SET MULTIPLE MODE, 0 = single-sector commands
+    uint8_t pio;            // PIO mode of data register transfers
+} CfSlotInfo;
+
+static CfSlotInfo cf_slot[CF_SLOTS];
 
 // ===== EXTERNAL FUNCTION DECLARATIONS - USE WORKING DRIVER FUNCTIONS =====
 
 // External function declarations from working driver
 extern uint16_t get_CE_pin(CartridgeID id);
-extern void short_delay_us(uint32_t us);
 extern void write_address_port(uint8_t data);
 extern void DataBus_SetOutput(void);
 extern void DataBus_SetInput(void);
@@ -66,6 +99,177 @@ static inline void GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, uint8_t
     }
 }
 
+
+// ===== CF REGISTER ACCESS =====
+
+// Write one task-file register; the bus must already be an output
+static void cf_write_reg(uint8_t reg, uint8_t value)
+{
+    write_address_port(reg);
+    delay_ns(CF_tAS_NS);
+    DataBus_WriteByte(value);
+    delay_ns(CF_tDS_NS);
+    GPIO_WritePin(GPIOD, CF_WE, 0);
+    delay_ns(CF_tPW_NS);
+    GPIO_WritePin(GPIOD, CF_WE, 1);
+    delay_ns(CF_tREC_NS);
+}
+
+// Strobe the register already on the address port; the bus must be an input
+static inline uint8_t cf_read_selected(void)
+{
+    GPIO_WritePin(GPIOB, CF_OE, 0);
+    delay_ns(CF_tPW_NS);
+    uint8_t value = DataBus_ReadByte();
+    GPIO_WritePin(GPIOB, CF_OE, 1);
+    return value;
+}
+
+// Load the task file for an LBA command on count sectors and issue it
+static void cf_issue(uint8_t cmd, DWORD sector, BYTE count)
+{
+    DataBus_Configure(DIR_OUTPUT);
+    cf_write_reg(sector_count, count);
+    cf_write_reg(sector_num, sector & 0xFF);
+    cf_write_reg(cyc_low, (sector >> 8) & 0xFF);
+    cf_write_reg(cyc_high, (sector >> 16) & 0xFF);
+    cf_write_reg(drive, 0xE0 | ((sector >> 24) & 0x0F));   // LBA mode, device 0
+    cf_write_reg(command, cmd);
+    delay_us(100);  // Wait for command acceptance
+}
+
+// Wait for BSY to clear; returns the final status, with BSY still set on timeout
+static uint8_t cf_wait_idle(uint32_t timeout_us)
+{
+    DataBus_Configure(DIR_INPUT);
+    write_address_port(status_reg);
+    delay_ns(CF_tSTATUS_NS);
+
+    deadline_t dl = deadline_us(timeout_us);
+    uint8_t st;
+    do {
+        st = cf_read_selected();
+    } while ((st & ST_BSY) && !deadline_expired(&dl));
+    return st;
+}
+
+// Wait for the card to ask for (or offer) the next DRQ block; 0 when it does
+static int cf_wait_drq(void)
+{
+    uint8_t st = cf_wait_idle(CF_DRQ_TIMEOUT_US);
+
+    if ((st & (ST_BSY | ST_ERR | ST_DF)) || !(st & ST_DRQ))
+        return -1;
+    return 0;
+}
+
+// Move one DRQ block of sectors through the data register
+static void cf_read_block(BYTE* buff, UINT bytes, uint8_t pio)
+{
+    write_address_port(data_reg);
+    delay_us(10);
+
+    CF_ReadData(buff, (uint16_t)bytes, pio);
+}
+
+static void cf_write_block(const BYTE* buff, UINT bytes, uint8_t pio)
+{
+    DataBus_Configure(DIR_OUTPUT);
+    write_address_port(data_reg);
+    delay_us(10);
+
+    CF_WriteData(buff, (uint16_t)bytes, pio);
+}
+
+static inline uint16_t cf_identify_word(const BYTE* id, uint8_t word)
+{
+    return (uint16_t)(id[2 * word] | (id[2 * word + 1] << 8));
+}
+
+// Best PIO mode in an IDENTIFY block, capped at CF_PIO_LIMIT: words 64
+// (PIO3/4, valid when word 53 bit 1 is set) and 51 (PIO0-2, in the high byte)
+static uint8_t cf_identify_pio(const BYTE* id)
+{
+    uint8_t pio = CF_PIO_0;
+
+    if (cf_identify_word(id, 53) & 0x0002) {
+        uint16_t adv = cf_identify_word(id, 64);
+        if (adv & 0x0002)
+            pio = 4;
+        else if (adv & 0x0001)
+            pio = 3;
+    }
+    if (pio == CF_PIO_0) {
+        pio = (uint8_t)(cf_identify_word(id, 51) >> 8);
+        if (pio > 2)
+            pio = 2;
+    }
+    return (pio > CF_PIO_LIMIT) ? CF_PIO_LIMIT : pio;
+}
+
+// Read IDENTIFY DEVICE from the selected card into info; 0 on success.
+// On failure the slot keeps the conservative defaults.
+static int cf_identify(CfSlotInfo* info)
+{
+    BYTE id[CF_SECTOR_SIZE];   // Only needed here; disk_initialize runs from the main loop
+
+    info->sectors     = 0;
+    info->maxMultiple = 0;
+    info->pio         = CF_PIO_0;
+
+    cf_issue(ATA_IDENTIFY, 0, 0);
+    if (cf_wait_drq() != 0)
+        return -1;
+    cf_read_block(id, sizeof(id), CF_PIO_0);
+
+    info->sectors     = cf_identify_word(id, 60) |
+                        ((DWORD)cf_identify_word(id, 61) << 16);
+    info->maxMultiple = (uint8_t)cf_identify_word(id, 47);
+    info->pio         = cf_identify_pio(id);
+    return 0;
+}
+
+// Set the largest DRQ block the selected card accepts, a power of two no
+// bigger than the IDENTIFY limit. Cards that abort SET MULTIPLE MODE for
+// every size get 0 and stay on READ/WRITE SECTORS.
+static uint8_t cf_set_multiple(uint8_t maxMultiple)
+{
+    uint8_t n = CF_MULTIPLE_MAX;
+
+    if (maxMultiple != 0) {
+        n = 128;
+        while (n > maxMultiple)
+            n >>= 1;
+    }
+
+    for (; n >= 2; n >>= 1) {
+        cf_issue(ATA_SET_MULTIPLE, 0, n);
+        uint8_t st = cf_wait_idle(CF_DRQ_TIMEOUT_US);
+        if (!(st & (ST_BSY | ST_ERR)))
+            return n;
+    }
+    return 0;
+}
+
+// Sectors in the next DRQ block of a transfer with count sectors left
+static inline BYTE cf_block_sectors(uint8_t multiple, BYTE count)
+{
+    if (multiple == 0)
+        return 1;
+    return (count < multiple) ? count : multiple;
+}
+
+// Leave only pdrv's CE asserted. OE is high between accesses, so no card is
+// driving the bus while the selects change. Done on every call rather than
+// cached: the raw driver functions deassert CE behind diskio's back.
+static void cf_select(BYTE pdrv)
+{
+    for (BYTE cart = 0; cart < CF_SLOTS; cart++) {
+        GPIO_WritePin(GPIOD, get_CE_pin((CartridgeID)cart), cart != pdrv);
+    }
+    delay_us(5);  // CE setup time before first register access
+}
+
 // ===== FATFS INTERFACE FUNCTIONS =====
 
 // FatFs time function
@@ -77,9 +281,10 @@ DWORD get_fattime(void)
 // Disk initialization using direct CF logic
 DSTATUS disk_initialize(BYTE drv)
 {
-    if(drv != 0) return RES_PARERR;  // Only support drive 0
+    if(drv >= CF_SLOTS) return STA_NOINIT;
 
-    CartridgeID id = m_CartId;
+    CartridgeID id = (CartridgeID)drv;
+    cf_slot[id].ready = 0;
 
     // CF initialization: CE-only selection, no RST assertion (see comment below)
     DataBus_Configure(DIR_INPUT);
@@ -104,22 +309,22 @@ DSTATUS disk_initialize(BYTE drv)
     for(int cart = 0; cart < 4; cart++) {
         GPIO_WritePin(GPIOD, get_CE_pin((CartridgeID)cart), 1);
     }
-    blocking_delay_ms(5);    // Bus settle: all non-target cards fully tri-state outputs
+    delay_ms(5);            // Bus settle: all non-target cards fully tri-state outputs
     GPIO_WritePin(GPIOD, get_CE_pin(id), 0);  // Assert target CE only
-    short_delay_us(100);     // CE setup time before register access
+    delay_us(100);     // CE setup time before register access
 
     // Poll BSY (bit 7) and RDY (bit 6): up to 500ms.
     // After normal operations the card is immediately ready (exits on first poll).
     // After D3_Power_Cycle_SubCmdProcess, the handler already waits 500ms before
     // calling mount, so BSY is clear before disk_initialize is reached.
-    // blocking_delay_ms is DWT-based — safe in USB CDC ISR (no SysTick dependency).
+    // delay_ms is DWT-based — safe in USB CDC ISR (no SysTick dependency).
     DataBus_Configure(DIR_INPUT);
     int cf_ready = 0;
     for (int ms = 0; ms < 500; ms++) {
         write_address_port(status_reg);
-        short_delay_us(10);
+        delay_us(10);
         GPIO_WritePin(GPIOB, CF_OE, 0);
-        short_delay_us(2);
+        delay_ns(CF_tPW_NS);
         uint8_t st = DataBus_ReadByte();
         GPIO_WritePin(GPIOB, CF_OE, 1);
 
@@ -127,18 +332,19 @@ DSTATUS disk_initialize(BYTE drv)
             cf_ready = 1;
             break;
         }
-        blocking_delay_ms(1);
+        delay_ms(1);
     }
 
     if (cf_ready)
     {
-        disk_initialized = 1;
-        last_initialized_cart = id;
+        CfSlotInfo* info = &cf_slot[id];
+        cf_identify(info);
+        info->multiple = cf_set_multiple(info->maxMultiple);
+        info->ready = 1;
         return RES_OK;
     }
     else
     {
-        disk_initialized = 0;
         return STA_NOINIT;
     }
 }
@@ -146,23 +352,19 @@ DSTATUS disk_initialize(BYTE drv)
 // Disk status - perform actual CF status checking
 DSTATUS disk_status(BYTE drv)
 {
-    if(drv != 0) return RES_PARERR;
-    
-    // If disk not initialized or cartridge changed, return not ready
-    if (!disk_initialized || last_initialized_cart != m_CartId) {
-        return STA_NOINIT;  // Force initialization
+    if(drv >= CF_SLOTS) return STA_NOINIT;
+
+    // Slot never initialized, or invalidated: FatFs re-runs disk_initialize
+    if (!cf_slot[drv].ready) {
+        return STA_NOINIT;
     }
 
-    // Assert CE for the active cartridge before touching the bus.
-    // CE should already be asserted after disk_initialize / disk_read / disk_write,
-    // but guard here in case any raw driver call deasserted it.
-    GPIO_WritePin(GPIOD, get_CE_pin(m_CartId), 0);
-    short_delay_us(5);
+    cf_select(drv);
 
     // Check CF status register
     DataBus_Configure(DIR_INPUT);
     write_address_port(status_reg);
-    short_delay_us(10);
+    delay_us(10);
     GPIO_WritePin(GPIOB, CF_OE, 0);
     uint8_t current_status = DataBus_ReadByte();
     GPIO_WritePin(GPIOB, CF_OE, 1);
@@ -179,241 +381,65 @@ DSTATUS disk_status(BYTE drv)
     }
 }
 
-// Disk read using exact logic from ComprehensiveTest512
+// Disk read: one READ MULTIPLE (or READ SECTORS) command for the whole run,
+// then one BSY/DRQ handshake per DRQ block
 DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, BYTE count)
 {
-    if(drv != 0) return RES_PARERR;  // Only support drive 0
+    if(drv >= CF_SLOTS) return RES_PARERR;
     if(count == 0) return RES_PARERR;
 
-    // For now, only support single sector reads
-    if(count != 1) return RES_ERROR;
+    cf_select(drv);
 
-    // Assert CE for the active cartridge.
-    // disk_read must not rely on CE being left over from disk_initialize — any
-    // raw CF function (post_read_compact_flash / post_write_compact_flash) deasserts
-    // CE, silently breaking subsequent FatFS reads without this guard.
-    GPIO_WritePin(GPIOD, get_CE_pin(m_CartId), 0);
-    short_delay_us(5);  // CE setup time before first register access
+    uint8_t multiple = cf_slot[drv].multiple;
+    uint8_t pio = cf_slot[drv].pio;
+    cf_issue(multiple ? ATA_READ_MULTIPLE : ATA_READ_SECTORS, sector, count);
+    delay_us(500);  // First block: media access before polling
 
-    // === READ OPERATION - EXACT COPY FROM ComprehensiveTest512 ===
-    DataBus_Configure(DIR_OUTPUT);
-
-    // Set up read command for specified sector
-    write_address_port(sector_count);
-    short_delay_us(5);
-    DataBus_WriteByte(0x01);  // 1 sector
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(sector_num);
-    short_delay_us(5);
-    DataBus_WriteByte(sector & 0xFF);  // Sector number low byte
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(cyc_low);
-    short_delay_us(5);
-    DataBus_WriteByte((sector >> 8) & 0xFF);  // Cylinder low
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
+    while (count) {
+        BYTE n = cf_block_sectors(multiple, count);
 
-    write_address_port(cyc_high);
-    short_delay_us(5);
-    DataBus_WriteByte((sector >> 16) & 0xFF);  // Cylinder high
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(drive);
-    short_delay_us(5);
-    DataBus_WriteByte(0xE0 | ((sector >> 24) & 0x0F));  // Drive/head with LBA bits
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(command);
-    short_delay_us(5);
-    DataBus_WriteByte(0x20);  // Read sectors command
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(100);
+        if (cf_wait_drq() != 0) return RES_ERROR;  // Timeout or card error
 
-    // Wait for read command to complete and data ready
-    DataBus_Configure(DIR_INPUT);
-    write_address_port(status_reg);
-    short_delay_us(500);
-
-    uint8_t read_status;
-    // H4 fix: ~200ms timeout per sector (was 50000 × ~16.6µs ≈ 832ms).
-    // Must fail fast enough that multiple stuck sectors stay well under the 20s ISP timeout.
-    int timeout = 12000;
-    do {
-        GPIO_WritePin(GPIOB, CF_OE, 0);
-        short_delay_us(2);
-        read_status = DataBus_ReadByte();
-        GPIO_WritePin(GPIOB, CF_OE, 1);
-        short_delay_us(50);
-        timeout--;
-    } while (((read_status & 0x80) != 0 || (read_status & 0x08) == 0) && timeout > 0);
-
-    if(timeout == 0) return RES_ERROR;  // Timeout
-
-    // Read all 512 bytes
-    write_address_port(data_reg);
-    short_delay_us(10);
-
-    for (int i = 0; i < 512; i++) {
-        GPIO_WritePin(GPIOB, CF_OE, 0);
-        short_delay_us(2);
-        buff[i] = DataBus_ReadByte();
-        GPIO_WritePin(GPIOB, CF_OE, 1);
-        short_delay_us(2);
+        cf_read_block(buff, n * CF_SECTOR_SIZE, pio);
+        buff += n * CF_SECTOR_SIZE;
+        count -= n;
     }
 
     return RES_OK;
 }
 
-// Disk write using exact logic from ComprehensiveTest512
+// Disk write: one WRITE MULTIPLE (or WRITE SECTORS) command for the whole
+// run, then one BSY/DRQ handshake per DRQ block
 DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
 {
-    if(drv != 0) return RES_PARERR;  // Only support drive 0
+    if(drv >= CF_SLOTS) return RES_PARERR;
     if(count == 0) return RES_PARERR;
 
-    // For now, only support single sector writes
-    if(count != 1) return RES_ERROR;
+    cf_select(drv);
 
-    // Assert CE for the active cartridge — same reasoning as disk_read.
-    GPIO_WritePin(GPIOD, get_CE_pin(m_CartId), 0);
-    short_delay_us(5);  // CE setup time before first register access
+    uint8_t multiple = cf_slot[drv].multiple;
+    uint8_t pio = cf_slot[drv].pio;
+    cf_issue(multiple ? ATA_WRITE_MULTIPLE : ATA_WRITE_SECTORS, sector, count);
 
-    // === WRITE OPERATION - EXACT COPY FROM ComprehensiveTest512 ===
-    DataBus_Configure(DIR_OUTPUT);
+    while (count) {
+        BYTE n = cf_block_sectors(multiple, count);
 
-    // Set up write command for specified sector
-    write_address_port(sector_count);
-    short_delay_us(5);
-    DataBus_WriteByte(0x01);  // 1 sector
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
+        if (cf_wait_drq() != 0) return RES_ERROR;  // Timeout or card error
 
-    write_address_port(sector_num);
-    short_delay_us(5);
-    DataBus_WriteByte(sector & 0xFF);  // Sector number low byte
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(cyc_low);
-    short_delay_us(5);
-    DataBus_WriteByte((sector >> 8) & 0xFF);  // Cylinder low
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(cyc_high);
-    short_delay_us(5);
-    DataBus_WriteByte((sector >> 16) & 0xFF);  // Cylinder high
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(drive);
-    short_delay_us(5);
-    DataBus_WriteByte(0xE0 | ((sector >> 24) & 0x0F));  // Drive/head with LBA bits
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(10);
-
-    write_address_port(command);
-    short_delay_us(5);
-    DataBus_WriteByte(0x30);  // Write sectors command
-    short_delay_us(2);
-    GPIO_WritePin(GPIOD, CF_WE, 0);
-    short_delay_us(5);
-    GPIO_WritePin(GPIOD, CF_WE, 1);
-    short_delay_us(100);  // Wait for command acceptance
-
-    // Wait for CF to be ready for data (DRQ = 1)
-    DataBus_Configure(DIR_INPUT);
-    write_address_port(status_reg);
-    short_delay_us(100);
-
-    uint8_t write_status;
-    // H4 fix: ~200ms DRQ timeout (was 50000 × ~16.6µs ≈ 832ms).
-    int timeout = 12000;
-    do {
-        GPIO_WritePin(GPIOB, CF_OE, 0);
-        short_delay_us(2);
-        write_status = DataBus_ReadByte();
-        GPIO_WritePin(GPIOB, CF_OE, 1);
-        short_delay_us(50);
-        timeout--;
-    } while (((write_status & 0x80) != 0 || (write_status & 0x08) == 0) && timeout > 0);
-
-    if(timeout == 0) return RES_ERROR;  // Timeout
-
-    // Write all 512 bytes
-    DataBus_Configure(DIR_OUTPUT);
-    write_address_port(data_reg);
-    short_delay_us(10);
-
-    for (int i = 0; i < 512; i++) {
-        DataBus_WriteByte(buff[i]);
-        short_delay_us(1);
-        GPIO_WritePin(GPIOD, CF_WE, 0);
-        short_delay_us(2);
-        GPIO_WritePin(GPIOD, CF_WE, 1);
-        short_delay_us(1);
+        cf_write_block(buff, n * CF_SECTOR_SIZE, pio);
+        buff += n * CF_SECTOR_SIZE;
+        count -= n;
     }
 
     // Wait for write completion
-    DataBus_Configure(DIR_INPUT);
-    write_address_port(status_reg);
-    short_delay_us(1000);
+    delay_ms(1);
+    uint8_t st = cf_wait_idle(CF_DONE_TIMEOUT_US);
 
-    uint8_t write_complete_status;
-    // H4 fix: ~500ms write-complete timeout (was 100000 × ~32.6µs ≈ 3.26s).
-    timeout = 15000;
-    do {
-        GPIO_WritePin(GPIOB, CF_OE, 0);
-        short_delay_us(2);
-        write_complete_status = DataBus_ReadByte();
-        GPIO_WritePin(GPIOB, CF_OE, 1);
-        short_delay_us(100);
-        timeout--;
-    } while ((write_complete_status & 0x80) != 0 && timeout > 0);
+    if (st & ST_BSY) return RES_ERROR;  // Timeout
 
-    if(timeout == 0) return RES_ERROR;  // Timeout
-
-    // C3 fix: after BSY clears, check ERR (bit 0) and DF/Device Fault (bit 5).
+    // C3 fix: after BSY clears, check ERR and DF/Device Fault.
     // Previously RES_OK was returned unconditionally, silently swallowing write errors.
-    if (write_complete_status & 0x21)   // 0x21 = bit5 (DF) | bit0 (ERR)
+    if (st & (ST_DF | ST_ERR))
         return RES_ERROR;
 
     return RES_OK;
@@ -422,7 +448,7 @@ DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, BYTE count)
 // Disk I/O control (minimal implementation)
 DRESULT disk_ioctl(BYTE drv, BYTE cmd, DWORD* buff)
 {
-    if(drv != 0) return RES_PARERR;
+    if(drv >= CF_SLOTS) return RES_PARERR;
 
     switch(cmd)
     {
@@ -430,12 +456,10 @@ DRESULT disk_ioctl(BYTE drv, BYTE cmd, DWORD* buff)
             return RES_OK;  // Always synchronized for direct CF access
 
         case GET_SECTOR_COUNT:
-            // H3 fix: was hardcoded at 2,048,000 (1 GB) regardless of actual card.
-            // Overshooting causes FatFS mkfs to place clusters beyond the card's real
-            // end, corrupting the filesystem on cards smaller than 1 GB.
-            // 262,144 sectors = 128 MB — safe minimum for all CF cards used in this
-            // system. Replace with IDENTIFY DEVICE sector count if larger cards arrive.
-            *buff = 262144;
+            // Real size from IDENTIFY DEVICE, so f_mkfs sizes clusters and FATs
+            // for the card. Without it, fall back to 128 MB: overshooting would
+            // place clusters past the end of a smaller card.
+            *buff = cf_slot[drv].sectors ? cf_slot[drv].sectors : CF_DEFAULT_SECTORS;
             return RES_OK;
 
         case GET_SECTOR_SIZE:
@@ -443,7 +467,9 @@ DRESULT disk_ioctl(BYTE drv, BYTE cmd, DWORD* buff)
             return RES_OK;
 
         case GET_BLOCK_SIZE:
-            *buff = 1;  // Single sector erase block
+            // CF does not report its erase block; align the data area to the
+            // DRQ block instead so cluster runs map onto whole MULTIPLE transfers
+            *buff = cf_slot[drv].multiple ? cf_slot[drv].multiple : 1;
             return RES_OK;
 
         default:
@@ -451,24 +477,22 @@ DRESULT disk_ioctl(BYTE drv, BYTE cmd, DWORD* buff)
     }
 }
 
-void SetCartNo(CartridgeID id)
+// Force disk reinitialization of one slot, e.g. after its card was swapped
+DSTATUS ForceCartridgeReinit(CartridgeID id)
 {
-	if (m_CartId != id) {
-		disk_initialized = 0;  // Force re-initialization when cart changes
-		last_initialized_cart = (CartridgeID)-1;  // Clear last initialized cart
-	}
-	m_CartId = id;
+    if ((BYTE)id >= CF_SLOTS) return STA_NOINIT;
+
+    cf_slot[id].ready = 0;
+    return disk_initialize((BYTE)id);
 }
 
-// Force disk reinitialization - call this when switching cartridges
-DSTATUS ForceCartridgeReinit(CartridgeID id)
+// Forget what disk_initialize set up for one slot, e.g. when its card is
+// removed; IDENTIFY, PIO and SET MULTIPLE are redone on the next access
+void InvalidateCartridge(CartridgeID id)
 {
-    SetCartNo(id);
-    disk_initialized = 0;
-    last_initialized_cart = (CartridgeID)-1;
-    
-    // Force immediate reinitialization
-    return disk_initialize(0);
+    if ((BYTE)id >= CF_SLOTS) return;
+
+    cf_slot[id].ready = 0;
 }
 
 #endif
\ No newline at end of file
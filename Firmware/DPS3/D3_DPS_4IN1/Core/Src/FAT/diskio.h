@@ -22,8 +22,8 @@ void Delay(unsigned int,unsigned int);
 unsigned char ChkCFRdyForCmd(void);
 unsigned char ChkCFRdyForData(void);
 void CfCmd(unsigned int,unsigned char,unsigned char);
-void SetCartNo(CartridgeID id);
 DSTATUS ForceCartridgeReinit(CartridgeID id);
+void InvalidateCartridge(CartridgeID id);
 
 typedef enum {
 	RES_OK = 0,		
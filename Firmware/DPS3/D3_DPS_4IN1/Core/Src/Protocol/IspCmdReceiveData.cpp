@@ -3,10 +3,28 @@
 #include "IspProtocolPacket.h"
 #include "IspFramingUtils.h"
 #include "safeBuffer.h"
+#include "main.h"
 #include <cstring>
 #include <cstdlib>
 // MAX_BUF_SIZE now defined in safeBuffer.h for unified buffer management
 
+// Chunk header is [cmd][seq 2B][len 1B] in v1 frames and [cmd][seq 2B][len 2B]
+// in large (v2) frames.  Returns the chunk data, or nullptr if truncated.
+static const uint8_t* parseChunk(const uint8_t* data, uint32_t len, uint16_t& seq, uint16_t& dataLen)
+{
+    uint32_t hdrLen = 4;
+    seq = (data[1] << 8) | data[2];
+    dataLen = data[3];
+    if (IspFramingUtils::largeFramesActive())
+    {
+        if (len < 5) return nullptr;
+        dataLen = (data[3] << 8) | data[4];
+        hdrLen = 5;
+    }
+    if (len < hdrLen + dataLen) return nullptr;
+    return &data[hdrLen];
+}
+
 IspCmdReceiveData::IspCmdReceiveData() : processor(nullptr) {
     reset();
 }
@@ -16,7 +34,8 @@ void IspCmdReceiveData::setSubProcessor(IspSubCommandProcessor* proc) {
 }
 
 bool IspCmdReceiveData::match(uint8_t cmd) {
-    return cmd == static_cast<uint8_t>(IspCommand::RX_DATA) || cmd == static_cast<uint8_t>(IspCommand::RX_DATA_RESET);
+    return cmd == static_cast<uint8_t>(IspCommand::RX_DATA) || cmd == static_cast<uint8_t>(IspCommand::RX_DATA_RESET)
+        || cmd == static_cast<uint8_t>(IspCommand::RX_DATA_WINDOWED);
 }
 
 void IspCmdReceiveData::execute(uint8_t* data, uint32_t len) {
@@ -24,7 +43,10 @@ void IspCmdReceiveData::execute(uint8_t* data, uint32_t len) {
     {
         handleStartCommand(data, len);
     } else if (currentState == State::RECEIVING && len >= 2) {
-        handleDataChunk(data, len);
+        if (windowed)
+            handleWindowedChunk(data, len);
+        else
+            handleDataChunk(data, len);
     }
     else if (data[0] == static_cast<uint8_t>(IspCommand::RX_DATA_RESET))
     {
@@ -32,19 +54,50 @@ void IspCmdReceiveData::execute(uint8_t* data, uint32_t len) {
     }
 }
 
+void IspCmdReceiveData::tick()
+{
+    // One step per pass, so frames are taken in and ACKed between steps
+    if (flushPending)
+        writePendingStep();
+
+    // The host has gone quiet, e.g. waiting on a lost chunk: report now
+    if (batchPending && currentState == State::RECEIVING &&
+        (HAL_GetTick() - lastChunkTime) >= ISP_ACK_BATCH_IDLE_MS)
+        sendAckBatch();
+}
+
 void IspCmdReceiveData::handleStartCommand(const uint8_t* data, uint32_t len)
 {
     subCommand = data[1];
     //totalSize = (data[2] << 8) | data[3];
     totalSize = (data[2] << 24) | (data[3] << 16) | (data[4] << 8) | (data[5]);
 
+    // RX_DATA_WINDOWED carries the requested window in data[6], ahead of
+    // the subcommand parameters
+    uint8_t hdrLen = 6;
+    if (data[0] == static_cast<uint8_t>(IspCommand::RX_DATA_WINDOWED) && len > 6)
+    {
+        windowed   = true;
+        ackBatch   = (data[6] & ISP_RX_WINDOW_ACK_BATCH) != 0;
+        windowSize = data[6] & ~ISP_RX_WINDOW_ACK_BATCH;
+        if (windowSize == 0)
+            windowSize = 1;
+        if (windowSize > ISP_MAX_RX_WINDOW)
+            windowSize = ISP_MAX_RX_WINDOW;
+        ackEvery = (windowSize > 1) ? (windowSize / 2) : 1;
+        hdrLen = 7;
+    }
+
     uint32_t res=0;
 
     // Logger removed: [RX] Start command received
 
     if (processor)
     {
-        res = processor->prepareForRx(subCommand, &data[6], len - 6);
+        writeStep = processor->rxWriteStep(subCommand);
+        if (writeStep == 0 || writeStep > MAX_BUF_SIZE)
+            writeStep = MAX_BUF_SIZE;
+        res = processor->prepareForRx(subCommand, &data[hdrLen], len - hdrLen);
     }
     else
     {
@@ -66,10 +119,11 @@ void IspCmdReceiveData::handleStartCommand(const uint8_t* data, uint32_t len)
     		// Darin3::processRxData runs closeWriteStream() → f_close(), which
     		// commits the (empty) file's directory entry to the CF card.
     		processor->processRxSubCommand(subCommand, &rxBuffer[0], 0);
-    		sendDoneAck(IspReturnCodes::SUBCMD_SUCESS);
     	}
-    	else
-    		sendDoneAck(IspReturnCodes::SUBCMD_FAILED);
+    	uint8_t slotCodes[ISP_MAX_SLOTS];
+    	uint8_t slots;
+    	IspReturnCodes code = collectSlotResults(res != 0, slotCodes, slots);
+    	sendDoneAck(code, slotCodes, slots);
     	reset();
     }
     else
@@ -77,6 +131,10 @@ void IspCmdReceiveData::handleStartCommand(const uint8_t* data, uint32_t len)
     	currentState = State::RECEIVING;
     	receivedSize = 0;
     	expectedSeq  = 0;
+    	chunkSize     = IspFramingUtils::largeFramesActive() ? ISP_LARGE_CHUNK_SIZE : ISP_MAX_CHUNK_SIZE;
+    	ackedSeq      = 0;
+    	nextUnseenSeq = 0;
+    	oooMask       = 0;
 
     	// Logger removed
     	sendRXAck(subCommand);
@@ -87,10 +145,11 @@ void IspCmdReceiveData::handleDataChunk(const uint8_t* data, uint32_t len)
 {
     if (len < 2) return;
 
-    uint16_t seq = (data[1] << 8) | data[2];
-    uint8_t dataLen = data[3];
+    uint16_t seq;
+    uint16_t dataLen;
+    const uint8_t* chunk = parseChunk(data, len, seq, dataLen);
 
-    if (len < (uint16_t)(4 + dataLen))
+    if (!chunk)
     {
         // Invalid packet length
         return;
@@ -106,18 +165,13 @@ void IspCmdReceiveData::handleDataChunk(const uint8_t* data, uint32_t len)
     
     if (seq == expectedSeq && (receivedSize + dataLen) <= totalSize)
     {
-        // Check if adding this data would exceed buffer BEFORE writing
-        if (receivedSize + dataLen > MAX_BUF_SIZE && totalSize > MAX_BUF_SIZE) {
-            // Process accumulated data first to make room
-            processor->processRxSubCommand(subCommand, rxBuffer, receivedSize);
-            
-            // Update totalSize BEFORE clearing receivedSize
-            totalSize -= receivedSize;
-            // Clear buffer for new data
-            receivedSize = 0;
-        }
-        
-        if (!SafeWriteToRxBuffer(&data[4], receivedSize, dataLen))
+        // Legacy hosts treat BUFFER_OVERFLOW as fatal, so wait for the
+        // previous half here rather than push back
+        if (flushPending && receivedSize + dataLen > MAX_BUF_SIZE)
+            writePendingHalf();
+
+        // Straight from the frame to its final place in rxBuffer
+        if (!storeChunk(receivedSize, chunk, dataLen))
         {
             // Logger removed
             sendNack(expectedSeq, IspReturnCodes::BUFFER_OVERFLOW);
@@ -125,37 +179,11 @@ void IspCmdReceiveData::handleDataChunk(const uint8_t* data, uint32_t len)
         }
 
         receivedSize += dataLen;
+        flushFullHalves();
 
-        if (receivedSize >= MAX_BUF_SIZE && totalSize > MAX_BUF_SIZE)
+        if (receivedSize >= totalSize)
         {
-        	// Process 4KB chunk and send to Darin3 for immediate handling
-        	processor->processRxSubCommand(subCommand, rxBuffer, MAX_BUF_SIZE);
-        	sendAck(seq, IspReturnCodes::SUBCMD_SEQMATCH);
-        	expectedSeq++;
-
-        	// Slide remaining data to beginning of buffer
-        	size_t leftover = receivedSize - MAX_BUF_SIZE;
-        	memmove(rxBuffer, rxBuffer + MAX_BUF_SIZE, leftover);
-        	receivedSize = leftover;
-        	totalSize  -= MAX_BUF_SIZE;
-        	// State remains RECEIVING for next chunk
-        }
-        else if (receivedSize >= totalSize)
-        {
-            if (processor)
-            {
-                uint8_t res = processor->processRxSubCommand(subCommand, &rxBuffer[0], receivedSize);
-                // Signal end of transfer with zero-length call
-                processor->processRxSubCommand(subCommand, &rxBuffer[0], 0);
-                if(!res)
-                  sendDoneAck(IspReturnCodes::SUBCMD_SUCESS);
-                else
-                  sendDoneAck(IspReturnCodes::SUBCMD_FAILED);
-            }
-            else
-            	sendDoneAck(IspReturnCodes::SUBCMD_NOTHANDLED);
-
-            reset();
+            finishTransfer();
         }
         else
         {
@@ -172,10 +200,234 @@ void IspCmdReceiveData::handleDataChunk(const uint8_t* data, uint32_t len)
 
 }
 
+void IspCmdReceiveData::handleWindowedChunk(const uint8_t* data, uint32_t len)
+{
+    if (len < 4) return;
+
+    uint16_t seq;
+    uint16_t dataLen;
+    const uint8_t* chunk = parseChunk(data, len, seq, dataLen);
+
+    if (!chunk || dataLen > chunkSize)
+    {
+        return;
+    }
+
+    lastChunkTime = HAL_GetTick();
+
+    // Already delivered: repeat the cumulative ACK so the host can slide
+    if (seq < expectedSeq)
+    {
+        if (ackBatch)
+            batchPending = true;
+        else
+            sendAck(expectedSeq - 1, IspReturnCodes::SUBCMD_SEQMATCH);
+        return;
+    }
+
+    uint16_t offset = seq - expectedSeq;
+    if (offset >= windowSize)
+    {
+        // Host ran past the window - fall back to the legacy resync
+        sendNack(expectedSeq, IspReturnCodes::SUBCMD_SEQMISMATCH);
+        return;
+    }
+
+    // Every chunk but the last must be full so its slot in rxBuffer is known
+    uint32_t pos = receivedSize + (uint32_t)offset * chunkSize;
+    if (pos + dataLen > totalSize ||
+        (dataLen != chunkSize && pos + dataLen != totalSize))
+    {
+        sendNack(seq, IspReturnCodes::SUBCMD_SEQMISMATCH);
+        return;
+    }
+
+    if (offset != 0)
+    {
+        // NACK only the gaps this frame has just revealed
+        uint16_t unseen = nextUnseenSeq - expectedSeq;
+        if (offset >= unseen)
+        {
+            for (uint16_t i = unseen; i < offset && !ackBatch; ++i)
+            {
+                if (!(oooMask & (1UL << i)))
+                    sendNack(expectedSeq + i, IspReturnCodes::SUBCMD_SEQMISMATCH);
+            }
+            nextUnseenSeq = seq + 1;
+        }
+        if (ackBatch)
+            batchPending = true;
+
+        if (oooMask & (1UL << offset))
+            return;
+
+        // Beyond both halves, or into the half still being written: forget
+        // it so it is NACKed again once later frames arrive
+        if (!storeChunk(pos, chunk, dataLen))
+        {
+            nextUnseenSeq = seq;
+            return;
+        }
+
+        oooMask |= (1UL << offset);
+
+        // In batch mode the gaps go out in the bitmap once the host has sent
+        // the whole window, or from tick() when it goes quiet
+        if (ackBatch && offset + 1 >= windowSize)
+            sendAckBatch();
+        return;
+    }
+
+    // Both halves busy: the host backs off and resends from expectedSeq
+    if (!storeChunk(receivedSize, chunk, dataLen))
+    {
+        sendNack(expectedSeq, IspReturnCodes::BUFFER_OVERFLOW);
+        return;
+    }
+
+    receivedSize += dataLen;
+    expectedSeq++;
+    oooMask >>= 1;
+    uint8_t advanced = 1;
+
+    // Deliver whatever the gap was holding back
+    while (oooMask & 1)
+    {
+        uint32_t remaining = totalSize - receivedSize;
+        receivedSize += (remaining > chunkSize) ? chunkSize : remaining;
+        expectedSeq++;
+        oooMask >>= 1;
+        advanced++;
+    }
+
+    if ((uint16_t)(nextUnseenSeq - expectedSeq) > windowSize)
+        nextUnseenSeq = expectedSeq;
+
+    // Chunks already stored past the boundary stay valid in the next half
+    bool flushed = (receivedSize >= MAX_BUF_SIZE && totalSize > MAX_BUF_SIZE);
+    flushFullHalves();
+
+    if (receivedSize >= totalSize)
+    {
+        finishTransfer();
+    }
+    else if (flushed || advanced > 1 || (uint16_t)(expectedSeq - ackedSeq) >= ackEvery)
+    {
+        // Cumulative: everything up to and including expectedSeq-1
+        if (ackBatch)
+        {
+            sendAckBatch();
+        }
+        else
+        {
+            sendAck(expectedSeq - 1, IspReturnCodes::SUBCMD_SEQMATCH);
+            ackedSeq = expectedSeq;
+        }
+    }
+    else if (ackBatch)
+    {
+        batchPending = true;
+    }
+}
+
+bool IspCmdReceiveData::storeChunk(uint32_t pos, const uint8_t* chunk, uint16_t len)
+{
+    if (pos + len > RX_BUFFER_SIZE) return false;
+    if (flushPending && pos + len > MAX_BUF_SIZE) return false;
+
+    // Split at the end of the half being filled and wrap into the other one
+    uint32_t base = fillHalf * MAX_BUF_SIZE;
+    uint32_t head = (pos < MAX_BUF_SIZE) ? MAX_BUF_SIZE - pos : 0;
+    if (head > len) head = len;
+
+    if (head && !SafeWriteToRxBuffer(chunk, base + pos, head))
+        return false;
+    if (head < len)
+    {
+        uint32_t wrapped = (base + pos + head) % RX_BUFFER_SIZE;
+        if (!SafeWriteToRxBuffer(chunk + head, wrapped, len - head))
+            return false;
+    }
+    return true;
+}
+
+void IspCmdReceiveData::flushFullHalves()
+{
+    while (receivedSize >= MAX_BUF_SIZE && totalSize > MAX_BUF_SIZE)
+    {
+        // Only one half can wait for the cartridge at a time
+        if (flushPending)
+            writePendingHalf();
+
+        flushPending  = true;
+        flushCursor   = 0;
+        fillHalf     ^= 1;
+        receivedSize -= MAX_BUF_SIZE;
+        totalSize    -= MAX_BUF_SIZE;
+    }
+}
+
+// Hand the next writeStep bytes of the pending half to the cartridge
+void IspCmdReceiveData::writePendingStep()
+{
+    uint32_t len = MAX_BUF_SIZE - flushCursor;
+    if (len > writeStep)
+        len = writeStep;
+
+    flushResult |= processor->processRxSubCommand(subCommand, &rxBuffer[(fillHalf ^ 1) * MAX_BUF_SIZE + flushCursor], len);
+    flushCursor += len;
+    if (flushCursor >= MAX_BUF_SIZE)
+        flushPending = false;
+}
+
+// Finish the pending half now, when its space is needed before tick() gets to it
+void IspCmdReceiveData::writePendingHalf()
+{
+    while (flushPending)
+        writePendingStep();
+}
+
+void IspCmdReceiveData::finishTransfer()
+{
+    if (processor)
+    {
+        // Earlier data first
+        if (flushPending)
+            writePendingHalf();
+
+        uint8_t res = processor->processRxSubCommand(subCommand, fillBuffer(), receivedSize) | flushResult;
+        // Signal end of transfer with zero-length call; closing the file can fail too
+        res |= processor->processRxSubCommand(subCommand, fillBuffer(), 0);
+
+        uint8_t slotCodes[ISP_MAX_SLOTS];
+        uint8_t slots;
+        IspReturnCodes code = collectSlotResults(res, slotCodes, slots);
+        sendDoneAck(code, slotCodes, slots);
+    }
+    else
+    	sendDoneAck(IspReturnCodes::SUBCMD_NOTHANDLED);
+
+    reset();
+}
+
 void IspCmdReceiveData::reset() {
     totalSize = receivedSize = expectedSeq = subCommand = 0;
     currentState = State::IDLE;
 
+    windowed = false;
+    windowSize = ackEvery = 1;
+    chunkSize = ISP_MAX_CHUNK_SIZE;
+    ackedSeq = nextUnseenSeq = 0;
+    oooMask = 0;
+    ackBatch = false;
+    batchPending = false;
+    lastChunkTime = 0;
+    fillHalf = 0;
+    flushPending = false;
+    flushCursor = 0;
+    writeStep = MAX_BUF_SIZE;
+    flushResult = 0;
+
     // Logger removed
 }
 
@@ -203,26 +455,73 @@ void IspCmdReceiveData::sendNack(uint16_t seq, IspReturnCodes retCode)
     }
 }
 
-void IspCmdReceiveData::sendDoneAck(IspReturnCodes retCode)
+// Multi-slot subcommands report through the handler's per-slot codes; the
+// transfer fails if any selected slot did
+IspReturnCodes IspCmdReceiveData::collectSlotResults(uint8_t res, uint8_t* slotCodes, uint8_t& slots)
 {
-    uint8_t done[4] = { static_cast<uint8_t>(IspResponse::ACK_DONE), (uint8_t)(expectedSeq >> 8), (uint8_t)(expectedSeq & 0xFF), static_cast<uint8_t>(retCode) };
+    slots = processor ? processor->getSlotResults(subCommand, slotCodes) : 0;
+    for (uint8_t i = 0; i < slots; ++i)
+    {
+        if (slotCodes[i] == static_cast<uint8_t>(IspReturnCodes::SUBCMD_FAILED))
+            res = 1;
+    }
+    return res ? IspReturnCodes::SUBCMD_FAILED : IspReturnCodes::SUBCMD_SUCESS;
+}
+
+// [ACK_DONE][seq 2B][retCode] followed, for multi-slot subcommands, by one
+// IspReturnCodes byte per slot.  Hosts that only read four bytes are unaffected.
+void IspCmdReceiveData::sendDoneAck(IspReturnCodes retCode, const uint8_t* slotCodes, uint8_t slots)
+{
+    uint8_t done[4 + ISP_MAX_SLOTS] = { static_cast<uint8_t>(IspResponse::ACK_DONE), (uint8_t)(expectedSeq >> 8), (uint8_t)(expectedSeq & 0xFF), static_cast<uint8_t>(retCode) };
+
+    if (slots > ISP_MAX_SLOTS) slots = ISP_MAX_SLOTS;
+    if (slots) memcpy(&done[4], slotCodes, slots);
 
     if (transport)
     {
         volatile uint8_t framed[30];
-        std::size_t frameLen = IspFramingUtils::encodeFrame(done, 4, framed, sizeof(framed));
+        std::size_t frameLen = IspFramingUtils::encodeFrame(done, 4 + slots, framed, sizeof(framed));
+        transport->transmit(framed, frameLen);
+    }
+}
+
+// [ACK_BATCH][base 2B][seen][mask 4B]: every chunk before base is stored;
+// of the next `seen` chunks, bit i of mask is set if base+i is stored and
+// clear if it is missing.  Chunks from base+seen on have not arrived yet.
+void IspCmdReceiveData::sendAckBatch()
+{
+    uint16_t seen = nextUnseenSeq - expectedSeq;
+    if (seen > windowSize) seen = 0;
+
+    uint8_t batch[8] = {
+        static_cast<uint8_t>(IspResponse::ACK_BATCH),
+        (uint8_t)(expectedSeq >> 8), (uint8_t)(expectedSeq & 0xFF),
+        (uint8_t)seen,
+        (uint8_t)(oooMask >> 24), (uint8_t)(oooMask >> 16), (uint8_t)(oooMask >> 8), (uint8_t)oooMask
+    };
+
+    if (transport)
+    {
+        volatile uint8_t framed[20];
+        std::size_t frameLen = IspFramingUtils::encodeFrame(batch, sizeof(batch), framed, sizeof(framed));
         transport->transmit(framed, frameLen);
     }
+
+    ackedSeq = expectedSeq;
+    batchPending = false;
 }
 
 void IspCmdReceiveData::sendRXAck(uint8_t subcmd)
 {
-    uint8_t ack[2] = { static_cast<uint8_t>(IspResponse::RX_MODE_ACK), subcmd };
+    // A windowed start is answered with the window actually granted, and
+    // with the ACK_BATCH bit if batch replies are on
+    uint8_t granted = windowSize | (ackBatch ? ISP_RX_WINDOW_ACK_BATCH : 0);
+    uint8_t ack[3] = { static_cast<uint8_t>(IspResponse::RX_MODE_ACK), subcmd, granted };
 
     if (transport)
     {
     	volatile uint8_t framed[20];
-        std::size_t frameLen = IspFramingUtils::encodeFrame(ack, 2, framed, sizeof(framed));
+        std::size_t frameLen = IspFramingUtils::encodeFrame(ack, windowed ? 3 : 2, framed, sizeof(framed));
         transport->transmit(framed, frameLen);
     }
 }
@@ -2,11 +2,23 @@
 #include "IspProtocolDefs.h"
 #include "IspFramingUtils.h"
 #include "safeBuffer.h"
+#include "main.h"
 #include <cstring>
 
 IspCmdTransmitData::IspCmdTransmitData() : processor(nullptr) {
     txSize = sentSize = currentSeq = subCommand = 0;
     currentState = State::IDLE;
+    windowed = false;
+    windowSize = 1;
+    nextSeq = windowBase = rewindSeq = 0;
+    fillEnd = 0;
+    rewindPending = false;
+    sendPending = false;
+    pendingSeq = pendingLen = 0;
+    pendingPos = 0;
+    frameFormat = IspFrameFormat::V1;
+    chunkSize = ISP_MAX_CHUNK_SIZE;
+    framesPerFill = (MAX_BUF_SIZE + ISP_MAX_CHUNK_SIZE - 1) / ISP_MAX_CHUNK_SIZE;
     // Logger removed
 }
 
@@ -19,6 +31,13 @@ void IspCmdTransmitData::setDataToSend(uint32_t size) {
     sentSize = 0;
     currentSeq = 0;
     currentState = State::IDLE;
+    sendPending = false;
+    // Window state belongs to one transfer; only TX_DATA_WINDOWED sets it again
+    windowed = false;
+    windowSize = 1;
+    nextSeq = windowBase = 0;
+    fillEnd = 0;
+    rewindPending = false;
     // Logger removed
 }
 
@@ -33,6 +52,7 @@ void IspCmdTransmitData::startTransmission() {
 bool IspCmdTransmitData::match(uint8_t cmd) {
     return cmd == static_cast<uint8_t>(IspCommand::TX_DATA) ||
     		cmd == static_cast<uint8_t>(IspCommand::TX_DATA_RESET) ||
+           cmd == static_cast<uint8_t>(IspCommand::TX_DATA_WINDOWED) ||
            cmd == static_cast<uint8_t>(IspResponse::ACK) ||
            cmd == static_cast<uint8_t>(IspResponse::ACK_DONE) ||
            cmd == static_cast<uint8_t>(IspResponse::RX_MODE_ACK) ||
@@ -51,6 +71,7 @@ void IspCmdTransmitData::execute(uint8_t* data, uint32_t len) {
             break;
 
         case static_cast<uint8_t>(IspCommand::TX_DATA):
+        case static_cast<uint8_t>(IspCommand::TX_DATA_WINDOWED):
             handleTxDataCommand(data, len);
             break;
 
@@ -89,9 +110,18 @@ void IspCmdTransmitData::handleTxDataCommand(uint8_t* data, uint32_t len) {
 
     uint32_t totalLen = (data[2] << 24) | (data[3] << 16) | (data[4] << 8) | data[5];
 
+    // TX_DATA_WINDOWED carries the requested window in data[6], ahead of
+    // the subcommand parameters
+    uint8_t hdrLen = 6;
+    uint8_t requestedWindow = 0;
+    if (data[0] == static_cast<uint8_t>(IspCommand::TX_DATA_WINDOWED) && len > 6) {
+        requestedWindow = data[6];
+        hdrLen = 7;
+    }
+
     // Ask Darin3 to prepare for transmission and load first chunk
     uint32_t outLen = 0;
-    uint8_t status = processor->prepareTxData(subCommand, &data[6], outLen);
+    uint8_t status = processor->prepareTxData(subCommand, &data[hdrLen], outLen);
 
     if (status != 0 || outLen == 0) {
         sendTXNack(subCommand, status);
@@ -102,6 +132,31 @@ void IspCmdTransmitData::handleTxDataCommand(uint8_t* data, uint32_t len) {
     // Use the host's requested totalLen, not just the first chunk size
     // Device will stream the entire file using MAX_BUF_SIZE buffer chunks
     setDataToSend(totalLen);
+
+    frameFormat   = IspFramingUtils::frameFormat();
+    chunkSize     = (frameFormat != IspFrameFormat::V1) ? ISP_LARGE_CHUNK_SIZE : ISP_MAX_CHUNK_SIZE;
+    framesPerFill = (MAX_BUF_SIZE + chunkSize - 1) / chunkSize;
+
+    if (hdrLen == 7) {
+        if (txSize == 0 || !transport) {
+            reset();
+            return;
+        }
+        windowed   = true;
+        windowSize = requestedWindow ? requestedWindow : 1;
+        if (windowSize > ISP_MAX_TX_WINDOW)
+            windowSize = ISP_MAX_TX_WINDOW;
+        nextSeq = windowBase = 0;
+        rewindPending = false;
+        fillEnd = (txSize < MAX_BUF_SIZE) ? txSize : MAX_BUF_SIZE;
+        lastSendTime = HAL_GetTick();
+
+        // Frames go out from tick(); only the grant is sent from here
+        sendTXAck(subCommand);
+        currentState = State::WAIT_ACK;
+        return;
+    }
+
     startTransmission();
 }
 
@@ -110,6 +165,19 @@ void IspCmdTransmitData::handleAck(uint8_t* data, uint32_t len) {
 
     uint16_t ackedSeq = (data[1] << 8) | data[2];
 
+    if (windowed) {
+        // Cumulative: everything up to and including ackedSeq has arrived.
+        // Stale ACKs are ignored; NACKs and the timeout in tick() recover.
+        uint16_t base = windowBase;
+        if ((uint16_t)(ackedSeq - base) < (uint16_t)(nextSeq - base)) {
+            windowBase = ackedSeq + 1;
+            lastSendTime = HAL_GetTick();
+            if (seqToPosition(ackedSeq + 1) >= txSize)
+                reset();  // Done; the next TX_DATA may be a legacy one
+        }
+        return;
+    }
+
     // Check if this is the ACK we're waiting for
     if (ackedSeq != currentSeq) {
         // Check if this is an old ACK (ackedSeq < currentSeq)
@@ -143,6 +211,17 @@ void IspCmdTransmitData::handleNack(uint8_t* data, uint32_t len) {
     uint16_t seq = (data[1] << 8) | data[2];
     IspReturnCodes code = static_cast<IspReturnCodes>(data[3]);
 
+    if (windowed) {
+        if (code == IspReturnCodes::SUBCMD_SEQMISMATCH || code == IspReturnCodes::BUFFER_OVERFLOW) {
+            // Go back to the missing frame on the next tick()
+            rewindSeq = seq;
+            rewindPending = true;
+        } else {
+            reset();
+        }
+        return;
+    }
+
     if (code == IspReturnCodes::SUBCMD_SEQMISMATCH) {
         // Sequence mismatch - resend the requested packet
         sendNextPacket(seq);
@@ -177,6 +256,68 @@ void IspCmdTransmitData::sendTXNack(uint8_t subcmd, uint8_t code) {
     }
 }
 
+void IspCmdTransmitData::sendTXAck(uint8_t subcmd) {
+    uint8_t ack[3] = {
+        static_cast<uint8_t>(IspResponse::TX_MODE_ACK),
+        subcmd,
+        windowSize
+    };
+
+    if (transport) {
+        uint8_t framed[20];
+        std::size_t frameLen = IspFramingUtils::encodeFrame(ack, 3, framed, sizeof(framed));
+        transport->transmit(framed, frameLen);
+    }
+}
+
+void IspCmdTransmitData::tick() {
+    if (sendPending) {
+        if (transport && transport->status() != IspTransportStatus::BUSY)
+            sendChunk(pendingSeq, pendingPos, pendingLen);
+        return;
+    }
+
+    if (!windowed || currentState != State::WAIT_ACK || !transport || !processor) return;
+
+    // txFrame may still be on the wire
+    if (transport->status() == IspTransportStatus::BUSY) return;
+
+    uint16_t base = windowBase;
+
+    if (rewindPending) {
+        rewindPending = false;
+        uint16_t seq = rewindSeq;
+        if ((uint16_t)(seq - base) < (uint16_t)(nextSeq - base))
+            nextSeq = seq;
+        lastSendTime = HAL_GetTick();
+    } else if (nextSeq != base && (HAL_GetTick() - lastSendTime) > TIMEOUT_MS) {
+        // Nothing acknowledged for a while - resend the whole window
+        nextSeq = base;
+        lastSendTime = HAL_GetTick();
+    }
+
+    // Everything from the current fill is acknowledged: load the next one
+    if (nextSeq == base && seqToPosition(nextSeq) >= fillEnd && fillEnd < txSize) {
+        uint32_t outLen = 0;
+        uint8_t status = processor->prepareTxData(subCommand, nullptr, outLen);
+        if (status != 0 || outLen == 0) {
+            // No more data or error - send zero-length packet to signal end
+            sendChunk(nextSeq, 0, 0);
+            reset();
+            return;
+        }
+        fillEnd = (txSize - fillEnd > MAX_BUF_SIZE) ? fillEnd + MAX_BUF_SIZE : txSize;
+    }
+
+    // Keep the window full; a busy transport just ends this round.  Check
+    // before each frame, as encoding the next one overwrites txFrame
+    while ((uint16_t)(nextSeq - base) < windowSize && seqToPosition(nextSeq) < fillEnd) {
+        if (transport->status() == IspTransportStatus::BUSY || !resendPacketForSequence(nextSeq))
+            break;
+        nextSeq++;
+    }
+}
+
 void IspCmdTransmitData::sendNextPacket(uint16_t seq) {
     if (!transport || !processor) return;
 
@@ -190,15 +331,7 @@ void IspCmdTransmitData::sendNextPacket(uint16_t seq) {
         uint8_t status = processor->prepareTxData(subCommand, nullptr, outLen);
         if (status != 0 || outLen == 0) {
             // No more data or error - send zero-length packet to signal end
-            uint8_t packet[4];
-            packet[0] = static_cast<uint8_t>(IspCommand::RX_DATA);
-            packet[1] = seq >> 8;
-            packet[2] = seq & 0xFF;
-            packet[3] = 0; // Zero length
-
-            uint8_t framed[20];
-            std::size_t frameLen = IspFramingUtils::encodeFrame(packet, 4, framed, sizeof(framed));
-            transport->transmit(framed, frameLen);
+            sendChunk(seq, 0, 0);
 
             currentState = State::IDLE;
             return;
@@ -213,60 +346,75 @@ void IspCmdTransmitData::sendNextPacket(uint16_t seq) {
         return;
     }
 
-    uint8_t chunkSize = (remainingBytes >= 56) ? 56 : remainingBytes;
+    uint16_t packetSize = (remainingBytes >= chunkSize) ? chunkSize : remainingBytes;
 
     // Ensure we don't read past buffer boundary
-    if (bufferPos + chunkSize > MAX_BUF_SIZE) {
-        chunkSize = MAX_BUF_SIZE - bufferPos;
+    if (bufferPos + packetSize > MAX_BUF_SIZE) {
+        packetSize = MAX_BUF_SIZE - bufferPos;
     }
 
     // Store packet info for potential retransmission
     lastSentSeq = seq;
-    lastSentPacketSize = chunkSize;
-    memcpy(lastSentPacket, &txBuffer[bufferPos], chunkSize);
-
-    uint8_t packet[60];
-    packet[0] = static_cast<uint8_t>(IspCommand::RX_DATA);
-    packet[1] = seq >> 8;
-    packet[2] = seq & 0xFF;
-    packet[3] = chunkSize;
-
-    memcpy(&packet[4], &txBuffer[bufferPos], chunkSize);
+    lastSentPacketSize = packetSize;
 
-    uint8_t framed[100];
-    std::size_t frameLen = IspFramingUtils::encodeFrame(packet, chunkSize + 4, framed, sizeof(framed));
-    transport->transmit(framed, frameLen);
+    sendChunk(seq, bufferPos, packetSize);
 
     // Don't update sentSize here - wait for ACK confirmation
     // The completion check will happen in handleAck() after successful ACK
 }
 
-void IspCmdTransmitData::resendPacketForSequence(uint16_t seq) {
-    if (!transport) return;
+uint32_t IspCmdTransmitData::seqToPosition(uint16_t seq) const {
+    // The last frame of each fill is short when MAX_BUF_SIZE is not a
+    // multiple of the chunk size, so count whole fills first
+    return (uint32_t)(seq / framesPerFill) * MAX_BUF_SIZE +
+           (uint32_t)(seq % framesPerFill) * chunkSize;
+}
+
+bool IspCmdTransmitData::sendChunk(uint16_t seq, uint32_t bufferPos, uint16_t len) {
+    uint8_t header[5];
+    uint8_t hdrLen = 4;
+    header[0] = static_cast<uint8_t>(IspCommand::RX_DATA);
+    header[1] = seq >> 8;
+    header[2] = seq & 0xFF;
+    if (frameFormat != IspFrameFormat::V1) {
+        header[3] = len >> 8;
+        header[4] = len & 0xFF;
+        hdrLen = 5;
+    } else {
+        header[3] = static_cast<uint8_t>(len);
+    }
+
+    std::size_t frameLen = IspFramingUtils::encodeFrame(frameFormat, header, hdrLen, &txBuffer[bufferPos], len,
+                                                        txFrame, sizeof(txFrame));
+    bool sent = transport->transmit(txFrame, frameLen);
+
+    // The windowed path resends from tick() on its own; legacy mode keeps
+    // the chunk until the transport takes it
+    if (!windowed) {
+        sendPending = !sent;
+        pendingSeq  = seq;
+        pendingPos  = bufferPos;
+        pendingLen  = len;
+    }
+    return sent;
+}
+
+bool IspCmdTransmitData::resendPacketForSequence(uint16_t seq) {
+    if (!transport) return false;
 
     // Calculate the position in the buffer for this sequence
-    uint32_t position = seq * 56;
-    if (position >= txSize) return;
+    uint32_t position = seqToPosition(seq);
+    if (position >= txSize) return false;
 
     uint32_t bufferPos = position % MAX_BUF_SIZE;
-    uint8_t chunkSize = (txSize - position >= 56) ? 56 : (txSize - position);
+    uint16_t packetSize = (txSize - position >= chunkSize) ? chunkSize : (txSize - position);
 
     // Ensure we don't read past buffer boundary
-    if (bufferPos + chunkSize > MAX_BUF_SIZE) {
-        chunkSize = MAX_BUF_SIZE - bufferPos;
+    if (bufferPos + packetSize > MAX_BUF_SIZE) {
+        packetSize = MAX_BUF_SIZE - bufferPos;
     }
 
-    uint8_t packet[60];
-    packet[0] = static_cast<uint8_t>(IspCommand::RX_DATA);
-    packet[1] = seq >> 8;
-    packet[2] = seq & 0xFF;
-    packet[3] = chunkSize;
-
-    memcpy(&packet[4], &txBuffer[bufferPos], chunkSize);
-
-    uint8_t framed[100];
-    std::size_t frameLen = IspFramingUtils::encodeFrame(packet, chunkSize + 4, framed, sizeof(framed));
-    transport->transmit(framed, frameLen);
+    return sendChunk(seq, bufferPos, packetSize);
 }
 
 void IspCmdTransmitData::reset() {
@@ -277,6 +425,12 @@ void IspCmdTransmitData::reset() {
     currentState = State::IDLE;
     lastSentSeq = 0;
     lastSentPacketSize = 0;
+    windowed = false;
+    windowSize = 1;
+    nextSeq = windowBase = 0;
+    fillEnd = 0;
+    rewindPending = false;
+    sendPending = false;
 
     // Logger removed
 }
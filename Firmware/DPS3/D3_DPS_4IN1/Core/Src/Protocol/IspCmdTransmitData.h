@@ -13,6 +13,9 @@ extern "C" {
 #pragma once
 #include "IspCommandHandler.h"
 #include "IspSubCommandProcessor.h"
+#include "IspProtocolDefs.h"
+#include "IspFramingUtils.h"
+#include "safeBuffer.h"
 #include <cstdint>
 
 class IspCmdTransmitData : public IspCommandHandler {
@@ -21,7 +24,7 @@ public:
     void setSubProcessor(IspSubCommandProcessor* proc);
     bool match(uint8_t cmd) override;
     void execute(uint8_t* data, uint32_t len) override;
-   // void tick() override;
+    void tick() override;
 
     void setDataToSend(uint32_t size);
     void startTransmission();  // <-- NEW
@@ -48,13 +51,42 @@ private:
     uint8_t subCommand;
     IspSubCommandProcessor* processor;
     
-    // Retransmission support
+    // Retransmission support - packets are rebuilt from txBuffer by seq
     uint16_t lastSentSeq;
-    uint8_t lastSentPacketSize;
-    uint8_t lastSentPacket[60];  // Store last packet for retransmission
+    uint16_t lastSentPacketSize;
+
+    // Chunk layout, fixed for the whole transfer by the frame format the
+    // start command arrived in
+    IspFrameFormat frameFormat;
+    uint16_t chunkSize;
+    uint16_t framesPerFill;      // a MAX_BUF_SIZE fill always spans this many frames
+    uint8_t txFrame[ISP_MAX_FRAME_PAYLOAD + IspFramingUtils::MAX_OVERHEAD];
+
+    // Streaming mode (TX_DATA_WINDOWED).  handleAck only moves windowBase
+    // and handleNack only records a rewind; tick() puts frames on the wire
+    // and refills txBuffer once every frame of the current fill has been
+    // acknowledged.
+    bool windowed;
+    uint8_t windowSize;
+    uint16_t nextSeq;
+    uint32_t fillEnd;
+    volatile uint16_t windowBase;
+    volatile uint16_t rewindSeq;
+    volatile bool rewindPending;
+
+    // Legacy mode: a chunk the transport could not take yet (a large frame
+    // waits for the reply ring to drain).  tick() sends it again, as the
+    // windowed path does, rather than leave it to the host's timeout.
+    bool sendPending;
+    uint16_t pendingSeq;
+    uint32_t pendingPos;
+    uint16_t pendingLen;
 
     void sendNextPacket(uint16_t seq);
-    void resendPacketForSequence(uint16_t seq);
+    bool resendPacketForSequence(uint16_t seq);
+    bool sendChunk(uint16_t seq, uint32_t bufferPos, uint16_t len);
+    uint32_t seqToPosition(uint16_t seq) const;
+    void sendTXAck(uint8_t subcmd);
     void handleAckOrNack(const uint8_t* data, uint32_t len);
     static constexpr uint32_t TIMEOUT_MS = 2000;
 };
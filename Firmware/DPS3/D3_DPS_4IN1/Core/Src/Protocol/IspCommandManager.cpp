@@ -2,27 +2,39 @@
 #include "IspFramingUtils.h"
 #include "IspProtocolDefs.h"
 
+#ifdef STM32F411xE
+#include "stm32f4xx.h"
+#include "Timing.h"
+#endif
+
 IspCommandManager::IspCommandManager() : handlerCount(0), boardId(IspBoardId::DPS3_4_IN_1) {
     // Initialize handler array
     for (uint8_t i = 0; i < MAX_COMMAND_HANDLERS; i++) {
         handlers[i] = nullptr;
     }
+    for (uint16_t c = 0; c < 256; c++) {
+        dispatch[c] = ISP_NO_HANDLER;
+    }
 }
 
 void IspCommandManager::addHandler(IspCommandHandler* handler) {
-    if (handlerCount < MAX_COMMAND_HANDLERS) {
+    if (handlerCount < MAX_COMMAND_HANDLERS && handler) {
         handlers[handlerCount] = handler;
+
+        // Ask the handler once for every byte, so a frame costs one lookup
+        for (uint16_t c = 0; c < 256; c++) {
+            if (dispatch[c] == ISP_NO_HANDLER && handler->match(static_cast<uint8_t>(c))) {
+                dispatch[c] = handlerCount;
+            }
+        }
         handlerCount++;
     }
 }
 
 void IspCommandManager::handleData(uint8_t* payload, uint32_t payloadLen) {
-    uint8_t cmd = payload[0];
-    for (uint8_t i = 0; i < handlerCount; i++) {
-        if (handlers[i] && handlers[i]->match(cmd)) {
-            handlers[i]->execute(payload, payloadLen);  // <-- decoded payload
-            break;
-        }
+    uint8_t idx = dispatch[payload[0]];
+    if (idx != ISP_NO_HANDLER) {
+        handlers[idx]->execute(payload, payloadLen);  // <-- decoded payload
     }
 }
 
@@ -39,7 +51,31 @@ IspBoardId IspCommandManager::getBoardID()
 void IspCommandManager::tick() {
     for (uint8_t i = 0; i < handlerCount; i++) {
         if (handlers[i]) {
-            // handler->tick(); // Uncomment if needed
+            handlers[i]->tick();
         }
     }
 }
+
+#ifdef STM32F411xE
+// DWT is already running from timing_init()
+void IspDispatch_Benchmark(IspCommandManager& mgr, IspDispatchBenchResult& result)
+{
+    // 0xFF is never a subcommand and 0x00 never a command
+    uint8_t controlFrame[2] = { static_cast<uint8_t>(IspCommand::CMD_REQ), 0xFF };
+    uint8_t unclaimedFrame[2] = { 0x00, 0x00 };
+    const uint32_t frames = 1000;
+    uint32_t start;
+
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < frames; i++)
+        mgr.handleData(controlFrame, sizeof(controlFrame));
+    result.controlCycles = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    for (uint32_t i = 0; i < frames; i++)
+        mgr.handleData(unclaimedFrame, sizeof(unclaimedFrame));
+    result.unclaimedCycles = DWT->CYCCNT - start;
+
+    result.frames = frames;
+}
+#endif
@@ -1,54 +1,159 @@
 #pragma once
+#include "IspCrc.h"
 #include <cstdint>
 #include <cstddef>
 
+// Three frame formats share the link:
+//   v1 (legacy): [0x7E][len 1B][payload][CRC8][0x7F]           - fits one 64-byte USB packet
+//   v2 (large):  [0x7D][len 2B BE][payload][CRC16 BE][0x7F]    - may span several USB packets
+//   v2 CRC-32:   [0x7C][len 2B BE][payload][CRC32 BE][0x7F]    - as v2, checked by the CRC unit
+// Replies use the format of the last frame received from the host, so a host
+// that never sends a v2 frame only ever sees v1 frames.
+enum class IspFrameFormat : uint8_t {
+    V1,
+    V2_CRC16,
+    V2_CRC32
+};
+
 class IspFramingUtils {
 public:
-    static constexpr uint8_t START_BYTE = 0x7E;
-    static constexpr uint8_t END_BYTE   = 0x7F;
+    static constexpr uint8_t START_BYTE          = 0x7E;
+    static constexpr uint8_t START_BYTE_V2       = 0x7D;
+    static constexpr uint8_t START_BYTE_V2_CRC32 = 0x7C;
+    static constexpr uint8_t END_BYTE            = 0x7F;
+
+    static constexpr std::size_t V1_OVERHEAD = 4;
+    static constexpr std::size_t V2_OVERHEAD = 6;
+    static constexpr std::size_t V2_CRC32_OVERHEAD = 8;
+    static constexpr std::size_t MAX_OVERHEAD = V2_CRC32_OVERHEAD;
+    static constexpr std::size_t V1_MAX_PAYLOAD = 255;
+    static constexpr std::size_t V2_MAX_PAYLOAD = 4096;
+
+    static bool isStartByte(uint8_t b) {
+        return b == START_BYTE || b == START_BYTE_V2 || b == START_BYTE_V2_CRC32;
+    }
+
+    static IspFrameFormat formatOf(uint8_t startByte) {
+        if (startByte == START_BYTE_V2) return IspFrameFormat::V2_CRC16;
+        if (startByte == START_BYTE_V2_CRC32) return IspFrameFormat::V2_CRC32;
+        return IspFrameFormat::V1;
+    }
+
+    static void setFrameFormat(IspFrameFormat fmt) { currentFormat() = fmt; }
+    static IspFrameFormat frameFormat() { return currentFormat(); }
+    static bool largeFramesActive() { return currentFormat() != IspFrameFormat::V1; }
 
-    // Wrap a payload into a framed packet using CRC8
+    // Total length of the frame whose first avail bytes are at buf, or 0 if
+    // the length field has not arrived yet
+    static std::size_t frameLength(const uint8_t* buf, std::size_t avail) {
+        if (avail < 2) return 0;
+        if (buf[0] == START_BYTE) return buf[1] + V1_OVERHEAD;
+        if (avail < 3) return 0;
+        std::size_t len = (std::size_t)(buf[1] << 8) | buf[2];
+        return len + (buf[0] == START_BYTE_V2_CRC32 ? V2_CRC32_OVERHEAD : V2_OVERHEAD);
+    }
+
+    // Wrap a payload into a framed packet in the link's current format
     static std::size_t encodeFrame(const uint8_t* payload, std::size_t len, volatile uint8_t* outBuf, std::size_t outMax) {
-        if (outMax < len + 4) return 0;
-        outBuf[0] = START_BYTE;
-        outBuf[1] = static_cast<uint8_t>(len);
-        for (std::size_t i = 0; i < len; ++i) {
-            outBuf[2 + i] = payload[i];
+        return encodeFrame(frameFormat(), payload, len, nullptr, 0, outBuf, outMax);
+    }
+
+    // Same, with the payload given as head + body so data chunks can be
+    // framed straight out of txBuffer
+    static std::size_t encodeFrame(IspFrameFormat fmt, const uint8_t* head, std::size_t headLen,
+                                   const uint8_t* body, std::size_t bodyLen,
+                                   volatile uint8_t* outBuf, std::size_t outMax) {
+        std::size_t len = headLen + bodyLen;
+        std::size_t pos = 0;
+
+        if (fmt == IspFrameFormat::V1) {
+            if (len > V1_MAX_PAYLOAD || outMax < len + V1_OVERHEAD) return 0;
+            outBuf[pos++] = START_BYTE;
+            outBuf[pos++] = static_cast<uint8_t>(len);
+        } else {
+            bool crc32 = (fmt == IspFrameFormat::V2_CRC32);
+            if (len > V2_MAX_PAYLOAD || outMax < len + (crc32 ? V2_CRC32_OVERHEAD : V2_OVERHEAD)) return 0;
+            outBuf[pos++] = crc32 ? START_BYTE_V2_CRC32 : START_BYTE_V2;
+            outBuf[pos++] = static_cast<uint8_t>(len >> 8);
+            outBuf[pos++] = static_cast<uint8_t>(len);
         }
-        outBuf[2 + len] = computeCRC8(payload, len);
-        outBuf[3 + len] = END_BYTE;
-        return len + 4;
+
+        std::size_t payloadPos = pos;
+        for (std::size_t i = 0; i < headLen; ++i) {
+            outBuf[pos++] = head[i];
+        }
+        for (std::size_t i = 0; i < bodyLen; ++i) {
+            outBuf[pos++] = body[i];
+        }
+
+        if (fmt == IspFrameFormat::V1) {
+            uint8_t crc = IspCrc::crc8(head, headLen, 0x00);
+            outBuf[pos++] = IspCrc::crc8(body, bodyLen, crc);
+        } else if (fmt == IspFrameFormat::V2_CRC16) {
+            uint16_t crc = IspCrc::crc16(head, headLen, 0xFFFF);
+            crc = IspCrc::crc16(body, bodyLen, crc);
+            outBuf[pos++] = static_cast<uint8_t>(crc >> 8);
+            outBuf[pos++] = static_cast<uint8_t>(crc);
+        } else {
+            // The CRC unit cannot be resumed, so run it over the copied payload
+            uint32_t crc = IspCrc::crc32(const_cast<const uint8_t*>(&outBuf[payloadPos]), len);
+            outBuf[pos++] = static_cast<uint8_t>(crc >> 24);
+            outBuf[pos++] = static_cast<uint8_t>(crc >> 16);
+            outBuf[pos++] = static_cast<uint8_t>(crc >> 8);
+            outBuf[pos++] = static_cast<uint8_t>(crc);
+        }
+        outBuf[pos++] = END_BYTE;
+        return pos;
     }
 
-    // Decode and validate a framed packet
+    // Decode and validate a framed packet of any format
     static bool decodeFrame(const uint8_t* frame, std::size_t frameLen, uint8_t* outPayload, std::size_t& outLen) {
-        if (frameLen < 4 || frame[0] != START_BYTE || frame[frameLen - 1] != END_BYTE) return false;
-        std::size_t len = frame[1];
-        if (len + 4 != frameLen) return false;
-
-        uint8_t crc = frame[2 + len];
-        if (crc != computeCRC8(&frame[2], len)) return false;
+        const uint8_t* payload;
+        std::size_t len;
+        if (!validateFrame(frame, frameLen, payload, len)) return false;
 
         for (std::size_t i = 0; i < len; ++i) {
-            outPayload[i] = frame[2 + i];
+            outPayload[i] = payload[i];
         }
         outLen = len;
         return true;
     }
 
-private:
-    // Standard CRC-8 (polynomial 0x07, init 0x00)
-    static uint8_t computeCRC8(const uint8_t* data, std::size_t len) {
-        uint8_t crc = 0x00;
-        for (std::size_t i = 0; i < len; ++i) {
-            crc ^= data[i];
-            for (int j = 0; j < 8; ++j) {
-                if (crc & 0x80)
-                    crc = (crc << 1) ^ 0x07;
-                else
-                    crc <<= 1;
-            }
+    // Check a framed packet where it lies and point at its payload, without
+    // copying anything
+    static bool validateFrame(const uint8_t* frame, std::size_t frameLen, const uint8_t*& outPayload, std::size_t& outLen) {
+        if (frameLen < V1_OVERHEAD || frame[frameLen - 1] != END_BYTE) return false;
+        if (frameLength(frame, frameLen) != frameLen) return false;
+
+        std::size_t len;
+        const uint8_t* payload;
+        if (frame[0] == START_BYTE) {
+            len = frame[1];
+            payload = &frame[2];
+            if (payload[len] != IspCrc::crc8(payload, len, 0x00)) return false;
+        } else if (frame[0] == START_BYTE_V2) {
+            len = frameLen - V2_OVERHEAD;
+            payload = &frame[3];
+            uint16_t crc = (uint16_t)(payload[len] << 8) | payload[len + 1];
+            if (crc != IspCrc::crc16(payload, len, 0xFFFF)) return false;
+        } else if (frame[0] == START_BYTE_V2_CRC32) {
+            len = frameLen - V2_CRC32_OVERHEAD;
+            payload = &frame[3];
+            uint32_t crc = ((uint32_t)payload[len] << 24) | ((uint32_t)payload[len + 1] << 16) |
+                           ((uint32_t)payload[len + 2] << 8) | payload[len + 3];
+            if (crc != IspCrc::crc32(payload, len)) return false;
+        } else {
+            return false;
         }
-        return crc;
+
+        outPayload = payload;
+        outLen = len;
+        return true;
+    }
+
+private:
+    static volatile IspFrameFormat& currentFormat() {
+        static volatile IspFrameFormat format = IspFrameFormat::V1;
+        return format;
     }
 };
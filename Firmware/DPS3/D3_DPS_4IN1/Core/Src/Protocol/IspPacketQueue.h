@@ -0,0 +1,55 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C-compatible section (leave empty if needed)
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Single-producer/single-consumer queue of USB OUT packets.  The USB ISR is
+// the only writer of head and the main loop the only writer of tail, so no
+// locking is needed.  The endpoint is armed straight into writeSlot(), which
+// makes queueing a packet free; the main loop assembles and executes frames
+// from the queued packets in place.
+class IspPacketQueue {
+public:
+    static constexpr uint16_t SLOTS     = 16;   // power of two
+    static constexpr uint16_t SLOT_SIZE = 64;   // one full-speed bulk packet
+
+    IspPacketQueue();
+
+    // Producer (USB ISR)
+    uint8_t* writeSlot() { return slots[head & (SLOTS - 1)].data; }
+    bool canReceive() const { return (uint16_t)(head - tail) < SLOTS; }
+    bool commit(const uint8_t* data, uint16_t len);
+
+    // Consumer (main loop)
+    bool front(const uint8_t*& data, uint16_t& len) const;
+    void pop();
+
+    uint16_t depth() const { return (uint16_t)(head - tail); }
+    uint16_t highWater() const { return maxDepth; }
+    uint32_t dropped() const { return drops; }
+
+private:
+    struct Slot {
+        uint8_t data[SLOT_SIZE];
+        uint16_t len;
+    };
+
+    Slot slots[SLOTS];
+    volatile uint16_t head;       // free-running, written by the ISR only
+    volatile uint16_t tail;       // free-running, written by the main loop only
+    volatile uint16_t maxDepth;
+    volatile uint32_t drops;
+};
+
+#endif // __cplusplus
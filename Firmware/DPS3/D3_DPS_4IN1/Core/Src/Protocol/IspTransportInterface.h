@@ -7,7 +7,8 @@ enum class IspTransportStatus {
     OK,
     ERROR,
     TIMEOUT,
-    DISCONNECTED
+    DISCONNECTED,
+    BUSY            // previous transmit still in progress
 };
 
 class IspTransportInterface {
@@ -8,7 +8,14 @@ constexpr uint32_t MAX_BUF_SIZE = 1023;
 
 // Buffer sizes  
 constexpr uint32_t TX_BUFFER_SIZE = MAX_BUF_SIZE;
-constexpr uint32_t RX_BUFFER_SIZE = MAX_BUF_SIZE;
+constexpr uint32_t RX_BUFFER_SIZE = 2 * MAX_BUF_SIZE;   // two halves, see IspCmdReceiveData
+
+// Data bytes per RX_DATA/TX_DATA chunk when the host uses large (v2) frames:
+// one CF sector per chunk
+constexpr uint16_t ISP_LARGE_CHUNK_SIZE = 512;
+
+// Largest v2 payload this board accepts (16-bit chunk header + data)
+constexpr uint16_t ISP_MAX_FRAME_PAYLOAD = ISP_LARGE_CHUNK_SIZE + 5;
 
 // Global buffers (defined elsewhere)
 extern uint8_t txBuffer[TX_BUFFER_SIZE];
@@ -20,7 +20,10 @@
 extern "C" {
 #include "main.h"
 #include "usb_device.h"
+#include "usbd_cdc_if.h"
 #include "Darin3Cart_Driver.h"
+#include "Timing.h"
+#include "DataBus.h"
 #include "FAT/diskio.h"
 }
 
@@ -33,6 +36,9 @@ extern "C" {
 #include "Protocol/IspFramingUtils.h"
 #include "Protocol/IspCmdControl.h"
 #include "Protocol/SerialTransport.h"
+#include "Protocol/IspFrameAssembler.h"
+#include "Protocol/IspPacketQueue.h"
+#include "Protocol/IspProgress.h"
 // #include <memory>  // Removed to avoid STL dependencies
 
 void SystemClock_Config(void);
@@ -45,13 +51,19 @@ IspCmdReceiveData IspRx;
 IspCmdTransmitData IspTx;
 IspSubCommandProcessor subcmdProcess;
 IspCmdControl IspCtrl;
+IspFrameAssembler IspFrames;
+IspPacketQueue IspRxPackets;
+static volatile bool ispRxStalled = false;
 
 void UpdateSlotLed()
 {
 	GuiCtrlLed_SubCmdProcess obj;
+
+	// A swapped card must not reuse the old card's volume or settings
+	FatFsWrapper::getInstance().releaseSlots(UpdateD3SlotStatus());
+
 	if(obj.get_LedState() == 0)
 	{
-		UpdateD3SlotStatus();
 		int itr=0;
 		for (itr=0;itr<4;itr++)
 		{
@@ -87,15 +99,58 @@ void BlinkLed_PA1_PA8(uint16_t delay)
 
 }
 
-extern "C" void Isp_forward_data(const uint8_t* data, uint32_t len)
+static void Isp_dispatch_frame(const uint8_t* frame, std::size_t frameLen)
 {
-	uint8_t payload[256];
+	// The frame is checked where it lies (USB packet or assembler buffer) and
+	// the handlers read the payload from there
+	const uint8_t* payload = nullptr;
 	std::size_t payloadLen = 0;
-	if (len == 0 || !data) return;
-	if (IspFramingUtils::decodeFrame(data, len, payload, payloadLen))
+	if (IspFramingUtils::validateFrame(frame, frameLen, payload, payloadLen))
 	{
 		if (payloadLen == 0) return;
-		IspManager.handleData(&payload[0], payloadLen);
+		// Reply in whichever frame format the host is using
+		IspFramingUtils::setFrameFormat(IspFramingUtils::formatOf(frame[0]));
+		IspManager.handleData(const_cast<uint8_t*>(payload), payloadLen);
+	}
+}
+
+// USB ISR: queue the packet and return the buffer the next one should land
+// in, or nullptr to leave the endpoint NAKing until the main loop catches up
+extern "C" uint8_t* Isp_forward_data(const uint8_t* data, uint32_t len)
+{
+	if (len != 0 && data)
+		IspRxPackets.commit(data, (uint16_t)len);
+
+	if (!IspRxPackets.canReceive())
+	{
+		ispRxStalled = true;
+		return nullptr;
+	}
+	return IspRxPackets.writeSlot();
+}
+
+// USB ISR: the IN endpoint is free, send the next batch of queued replies
+extern "C" void Isp_tx_complete(void)
+{
+	usbTransport.onTxComplete();
+}
+
+// Main loop: assemble and execute the queued packets, so long cartridge
+// operations never run in interrupt context
+static void Isp_process_rx(void)
+{
+	const uint8_t* data;
+	uint16_t len;
+	while (IspRxPackets.front(data, len))
+	{
+		IspFrames.push(data, len, HAL_GetTick());
+		IspRxPackets.pop();
+
+		if (ispRxStalled)
+		{
+			ispRxStalled = false;
+			CDC_ReceiveInto_FS(IspRxPackets.writeSlot());
+		}
 	}
 }
 
@@ -108,13 +163,16 @@ int main(void)
 
   HAL_Init();
   SystemClock_Config();
+  timing_init();
   MX_GPIO_Init();
+  DataBus_Init();
   MX_USB_DEVICE_Init();
   HAL_GPIO_WritePin(GPIOD, POWER_CYCLE_1_Pin, GPIO_PIN_SET); //power on compact flash
   HAL_GPIO_WritePin(GPIOB, POWER_CYCLE_2_Pin, GPIO_PIN_SET); //power on compact flash
   HAL_GPIO_WritePin(GPIOB, POWER_CYCLE_3_Pin, GPIO_PIN_SET); //power on compact flash
   HAL_GPIO_WritePin(GPIOB, POWER_CYCLE_4_Pin, GPIO_PIN_SET); //power on compact flash
 
+  IspFrames.setFrameHandler(Isp_dispatch_frame);
   IspRx.setTransport(&usbTransport);
   IspTx.setTransport(&usbTransport);
   IspRx.setSubProcessor(&subcmdProcess);
@@ -125,6 +183,7 @@ int main(void)
 
   // Now IspCmdControl is STL-free and can be enabled
   IspCtrl.setTransport(&usbTransport);
+  IspProgress::setTransport(&usbTransport);
   IspCtrl.setSubProcessor(&subcmdProcess);
   IspManager.addHandler(&IspCtrl);
 
@@ -133,6 +192,10 @@ int main(void)
 
   // Create static handler objects to avoid memory leaks
   static FirmwareVersion_SubCmdProcess firmwareVersionHandler;
+  static LinkCaps_SubCmdProcess linkCapsHandler;
+  static BusBenchmark_SubCmdProcess busBenchmarkHandler;
+  static CrcBenchmark_SubCmdProcess crcBenchmarkHandler;
+  static DispatchBenchmark_SubCmdProcess dispatchBenchmarkHandler(IspManager);
   static BoardID_SubCmdProcess boardIdHandler;
   static GuiCtrlLed_SubCmdProcess guiCtrlLedHandler;
   static GreenLed_SubCmdProcess greenLedHandler;
@@ -147,6 +210,10 @@ int main(void)
 
   // Register control command handlers using static objects (no memory leaks)
   IspCtrl.registerSubCmdHandlers(&firmwareVersionHandler);
+  IspCtrl.registerSubCmdHandlers(&linkCapsHandler);
+  IspCtrl.registerSubCmdHandlers(&busBenchmarkHandler);
+  IspCtrl.registerSubCmdHandlers(&crcBenchmarkHandler);
+  IspCtrl.registerSubCmdHandlers(&dispatchBenchmarkHandler);
   IspCtrl.registerSubCmdHandlers(&boardIdHandler);
   IspCtrl.registerSubCmdHandlers(&guiCtrlLedHandler);
   IspCtrl.registerSubCmdHandlers(&greenLedHandler);
@@ -162,9 +229,12 @@ int main(void)
 
   // Register Darin3 handlers directly with subcmdProcess (using static object address)
   subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_WRITE), &darin3Obj); //Write
+  subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_WRITE_MULTI), &darin3Obj); //Write to several slots
   subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_READ), &darin3Obj); //Read
   subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_ERASE), &darin3Obj); //Erase
   subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_READ_FILES), &darin3Obj); //Read
+  subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_CART_COPY), &darin3Obj); //Copy between slots
+  subcmdProcess.registerHandler(static_cast<uint8_t>(IspSubCommand::D3_CART_COMPARE), &darin3Obj); //Compare between slots
 
   BlinkLed_PA1_PA8(350);
 
@@ -173,6 +243,8 @@ int main(void)
 
 
     UpdateSlotLed();
+    Isp_process_rx();
+    IspManager.tick();
     // ===== CHOOSE YOUR TEST =====
     // Option 1: Original working driver test
     //TesCompactFlashDriver(CARTRIDGE_1);
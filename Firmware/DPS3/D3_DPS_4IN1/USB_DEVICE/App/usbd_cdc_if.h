@@ -109,6 +109,8 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
+uint8_t CDC_IsTxBusy_FS(void);
+uint8_t CDC_ReceiveInto_FS(uint8_t* Buf);
 
 /* USER CODE END EXPORTED_FUNCTIONS */
 
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "Protocol/safeBuffer.h"
 #include "Protocol/IspProtocolDefs.h"
+#include "Protocol/IspProgress.h"
 
 Darin2::Darin2() {
 
@@ -11,21 +12,27 @@ Darin2::Darin2() {
 
 uint32_t Darin2::prepareForRx(const uint8_t* data, const uint8_t subcmd, uint32_t len)
 {
+    m_reportResult = false;  // Only an ECC write reports a slot result
+
     if (subcmd == (uint8_t)IspSubCommand::D2_ERASE)
     {
     	m_Address_Flash_Page = ((data[0] + 256 * data[1]));
     	m_cartID = static_cast<CartridgeID>(data[5] - 1);
 
+    	// Blocks that already read erased are skipped; one PROGRESS step per block
+    	unsigned char ans = 0;
+    	IspProgress::begin(subcmd, 1024);
     	pre_erase_flash(m_cartID);
-    	for (int i = 0; i < 1024; ++i)
+    	for (int i = 0; i < 1024 && !ans; ++i)
     	{
             int BlockAddress = ((i << 5));
-    		unsigned char ans = flash_erase(BlockAddress, m_cartID);
-    		if(ans)
-    		 return ans;
+            if (!flash_block_blank(BlockAddress, m_cartID))
+    		    ans = flash_erase(BlockAddress, m_cartID);
+            IspProgress::update(i + 1);
     	}
     	post_erase_flash(m_cartID);
-    	return 0;
+    	IspProgress::finish();
+    	return ans;
     }
     else if(subcmd == (uint8_t)IspSubCommand::D2_ERASE_BLOCK)
     {
@@ -41,52 +48,107 @@ uint32_t Darin2::prepareForRx(const uint8_t* data, const uint8_t subcmd, uint32_
       m_Address_Flash_Page = ((data[0] + 256 * data[1]));
       m_NumBlocks = data[2];
       m_Last_Block_size = data[3] + 256 * data[4];
-      m_cartID = static_cast<CartridgeID>(data[5] - 1);
+      m_ecc = (data[5] & ISP_D2_FLAG_ECC) != 0;
+      m_cartID = static_cast<CartridgeID>((data[5] & ~ISP_D2_FLAG_ECC) - 1);
+
+      // The read-back verify of an ECC write goes out as the slot result in ACK_DONE
+      m_reportResult = m_ecc;
+      m_result = (uint8_t)IspReturnCodes::SUBCMD_SUCESS;
       return 0;
     }
 }
 
+uint8_t Darin2::getSlotResults(uint8_t* codes)
+{
+    if (!m_reportResult)
+        return 0;
+
+    codes[0] = m_result;
+    m_reportResult = false;  // Reported once, with the ACK_DONE of this transfer
+    return 1;
+}
+
 uint8_t Darin2::processRxData(const uint8_t* data, const uint8_t subcmd, uint32_t len)
 {
-    int rxOffset = 0;
+    // The end-of-transfer call carries no data; the block was written with
+    // the data call and must not be erased and programmed again
+    if (len == 0)
+        return 0;
+
     int currentPage = m_Address_Flash_Page;
+    int totalPages = m_NumBlocks + (m_Last_Block_size > 0 ? 1 : 0);
 
+    // A block that still reads blank needs no erase
     pre_erase_flash(m_cartID);
-    flash_erase(currentPage, m_cartID);
+    if (!flash_block_blank(currentPage, m_cartID))
+        flash_erase(currentPage, m_cartID);
     post_erase_flash(m_cartID);
 
-    for (int i = 0; i < m_NumBlocks; ++i)
-    {
-        pre_write_flash(m_cartID);
-        flash_write(&data[rxOffset], 512, currentPage, m_cartID);
-        post_write_flash(m_cartID);
-        currentPage++;
-        rxOffset += 512;
-    }
+    uint8_t failed = 0;
 
-    if (m_Last_Block_size > 0)
+    flash_set_ecc(m_ecc);
+    pre_write_flash(m_cartID);
+    for (int i = 0; i < totalPages; ++i, ++currentPage)
     {
-        pre_write_flash(m_cartID);
-        flash_write(&data[rxOffset], m_Last_Block_size, currentPage, m_cartID);
-        post_write_flash(m_cartID);
-        rxOffset += m_Last_Block_size;
+        uint16_t size = (i < m_NumBlocks) ? 512 : m_Last_Block_size;
+        const uint8_t* page = &data[i * 512];
+
+        // An erased page already reads 0xFF, so all-0xFF pages are left alone
+        if (flash_page_blank(page, size))
+            continue;
+
+        failed |= flash_write(page, size, currentPage, m_cartID);
     }
+    post_write_flash(m_cartID);
+    flash_set_ecc(0);
 
-    storedLength = rxOffset;
+    if (!failed && m_ecc && !verifyWritten(data))
+        failed = 0xFF;
+    if (failed && m_ecc)
+        m_result = (uint8_t)IspReturnCodes::SUBCMD_FAILED;
 
-    return 0;
+    storedLength = m_NumBlocks * 512 + m_Last_Block_size;
+
+    return failed ? 1 : 0;
 
     //char msg[64];
     //std::sprintf(msg, "[D2] RX Done: Bytes=%d", storedLength);
    // SimpleLogger::getInstance().log(SimpleLogger::LOG_INFO, msg);
 }
 
+// Read back the pages of this transfer and check each against its ECC and
+// against the data sent.  Blank pages were not programmed and are skipped.
+// This takes the place of a host-side read and compare.
+bool Darin2::verifyWritten(const uint8_t* data)
+{
+    uint8_t page[512];
+    int totalPages = m_NumBlocks + (m_Last_Block_size > 0 ? 1 : 0);
+
+    for (int i = 0; i < totalPages; ++i)
+    {
+        uint16_t size = (i < m_NumBlocks) ? 512 : m_Last_Block_size;
+        const uint8_t* expected = &data[i * 512];
+
+        if (flash_page_blank(expected, size))
+            continue;
+
+        pre_read_flash(m_cartID);
+        uint8_t res = flash_read_ecc(page, m_Address_Flash_Page + i, m_cartID);
+        post_read_flash(m_cartID);
+
+        if (res != NAND_ECC_OK || memcmp(page, expected, size) != 0)
+            return false;
+    }
+    return true;
+}
+
 uint8_t Darin2::prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen)
 {
     int addressFlashPage = data[0] + (data[1] << 8);
     int numBlocks = data[2];
     int lastBlockSize = data[3] + (data[4] << 8);
-    m_cartID = static_cast<CartridgeID>(data[5]-1);
+    bool ecc = (data[5] & ISP_D2_FLAG_ECC) != 0;
+    m_cartID = static_cast<CartridgeID>((data[5] & ~ISP_D2_FLAG_ECC) - 1);
 
     int totalBytesToRead = numBlocks * 512 + lastBlockSize;
     int totalFlashPages = (totalBytesToRead + 511) / 512;
@@ -108,8 +170,18 @@ uint8_t Darin2::prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint3
         }
 
         uint8_t tempPage[512] = {0};
-        flash_read(tempPage, readSize, addressFlashPage, m_cartID);
-        post_read_flash(m_cartID);
+        if (ecc)
+        {
+            uint8_t res = flash_read_ecc(tempPage, addressFlashPage, m_cartID);
+            post_read_flash(m_cartID);
+            if (res == NAND_ECC_UNCORRECTABLE)
+                return (uint8_t)IspReturnCodes::SUBCMD_FAILED;
+        }
+        else
+        {
+            flash_read(tempPage, readSize, addressFlashPage, m_cartID);
+            post_read_flash(m_cartID);
+        }
 
         if (!SafeWriteToTxBuffer(tempPage, bufferOffset, readSize))
         {
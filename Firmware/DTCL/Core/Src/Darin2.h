@@ -1,6 +1,7 @@
 #pragma once
 #include "Protocol/IIspSubCommandHandler.h"
 #include "Darin2Cart_Driver.h"
+#include "NandEcc.h"
 #include "stm32f4xx_hal.h"
 #include "main.h"
 #include <stdint.h>
@@ -11,6 +12,7 @@ public:
 	uint32_t prepareForRx(const uint8_t* data, const uint8_t subcmd,uint32_t len) override;
 	uint8_t processRxData(const uint8_t* data, const uint8_t subcmd, uint32_t len) override;
     uint8_t prepareDataToTx(const uint8_t* data, const uint8_t subcmd, uint32_t& outLen) override;
+    uint8_t getSlotResults(uint8_t* codes) override;
     void TestDarinIIFlash(int startPage, int endPage);
 
 private:
@@ -23,4 +25,10 @@ private:
     int m_Last_Block_size;
     CartridgeID m_cartID;
 
+    bool verifyWritten(const uint8_t* data);
+
+    // ISP_D2_FLAG_ECC on the current write, and its verify result for ACK_DONE
+    bool m_ecc = false;
+    bool m_reportResult = false;
+    uint8_t m_result;
 };
@@ -20,6 +20,10 @@
 #include "stm32f4xx_hal.h"
 #include "main.h"
 #include "Darin2Cart_Driver.h"
+#include "DataBus.h"
+#include "Timing.h"
+#include "NandEcc.h"
+#include <string.h>
 
 /* Private Constants ---------------------------------------------------------*/
 
@@ -32,15 +36,35 @@ uint16_t F_CE  = C2CE1_Pin;              /* Chip Enable */
 uint16_t F_RD  = C2RE_Pin;               /* Read Enable */
 uint16_t F_WR  = C1A03_C2nWE_C3A03_Pin;  /* Write Enable (active low) */
 
-/* NAND Flash Data Bus Pins (8-bit) */
-uint16_t M_D7  = C2DB7_C3DB7_INOUT_Pin;  /* Data bit 7 */
-uint16_t M_D6  = C2DB6_C3DB6_Pin;        /* Data bit 6 */
-uint16_t M_D5  = C2DB5_C3DB5_INOUT_Pin;  /* Data bit 5 */
-uint16_t M_D4  = C2DB4_C3DB4_Pin;        /* Data bit 4 */
-uint16_t M_D3  = C2DB3_C3DB3_Pin;        /* Data bit 3 */
-uint16_t M_D2  = C2DB2_C3DB2_Pin;        /* Data bit 2 */
-uint16_t M_D1  = C2DB1_C3DB1_Pin;        /* Data bit 1 */
-uint16_t M_D0  = C2DB0_C3DB0_Pin;        /* Data bit 0 */
+/* Array operation limits from the K9K1G08 datasheet (maximum, not typical).
+ * R/B ends each wait as soon as the chip is done; these only bound it. */
+#define D2_tR_MAX_US     12U     /* Page read into the data register */
+#define D2_tPROG_MAX_US  500U    /* Page program */
+#define D2_tBERS_MAX_US  3000U   /* Block erase */
+
+/* Bus timings, minimum */
+#define D2_tCLS_NS       20U     /* CLE/ALE setup to WE rising */
+#define D2_tWP_NS        25U     /* WE pulse width */
+#define D2_tWH_NS        15U     /* WE high hold */
+#define D2_tDS_NS        20U     /* Data setup to WE rising */
+#define D2_tREA_NS       35U     /* RE low to data valid */
+#define D2_tREH_NS       15U     /* RE high hold */
+#define D2_tWHR_NS       60U     /* WE high to RE low */
+#define D2_tADL_NS       100U    /* Last address cycle to data loading */
+#define D2_tWB_NS        100U    /* Last WE rising edge to R/B low */
+
+/* Array geometry */
+#define D2_PAGE_SIZE        512U
+#define D2_PAGES_PER_BLOCK  32U
+
+/* Spare area use with ECC on: the first D2_SPARE_USED of its 16 bytes are
+ * loaded, byte 5 stays 0xFF as the factory bad block marker, and the marker
+ * byte tells a page with ECC from one written without */
+#define D2_SPARE_USED       8U
+#define D2_ECC_MARK_POS     4U
+#define D2_ECC_MARK         0x00U
+
+/* NAND Flash Data Bus: shared with Darin-III, driven through DataBus.h */
 
 /* Private Variables ---------------------------------------------------------*/
 
@@ -54,6 +78,46 @@ static const uint16_t GREEN_LED[]  = { LED2_Pin, LED2_Pin, LED2_Pin, LED2_Pin };
 /* Slot status tracking */
 static uint8_t SLT_STATUS[] = { 0, 0, 0, 0 };
 
+/* Spare bytes holding the six ECC bytes, as Linux lays out small-page OOB */
+static const uint8_t ECC_SPARE_POS[NAND_ECC_BYTES] = { 0, 1, 2, 3, 6, 7 };
+
+/* Set by flash_set_ecc(): programming writes ECC into the spare area */
+static uint8_t eccEnabled;
+
+static uint8_t read_status(void);
+
+//****************************************************************************
+//READY/BUSY
+//****************************************************************************
+
+// C2RB0 comes up as an output from MX_GPIO_Init; R/B is open drain, so
+// make it an input before anything waits on it
+static void Configure_RB_Input(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+	GPIO_InitStruct.Pin = C2RB0_Pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+}
+
+// Wait for R/B to go high after a read, program or erase command, for at
+// most the datasheet maximum of the operation.  0x00 once ready, 0xFF on
+// timeout.
+static uint8_t wait_ready(uint32_t max_us)
+{
+	// R/B only drops tWB after the command, so do not sample it before then
+	deadline_t deadline = deadline_us(max_us);
+	delay_ns(D2_tWB_NS);
+
+	while ((GPIOA->IDR & F_RDY) == 0)
+	{
+		if (deadline_expired(&deadline))
+			return 0xFF;
+	}
+	return 0x00;
+}
+
 //****************************************************************************
 //PRE FLASH WRITE
 //****************************************************************************
@@ -62,6 +126,7 @@ void pre_write_flash(CartridgeID id)		//pre setting of port pins before writing
 {
 
    Configure_GPIO_IO_D2(Output);    //port P1 is declared as output port
+   Configure_RB_Input();
 
    GPIOB->BSRR = (uint32_t)F_ALE << 16;		             //disable address latch enable pin of flash
    GPIOB->BSRR = F_WP;	                 //disable write protect pin of flash
@@ -74,15 +139,51 @@ void pre_write_flash(CartridgeID id)		//pre setting of port pins before writing
 //**********************************************************************************
 //Function To Write
 //**********************************************************************************
-void flash_write(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page,CartridgeID id)
+
+// ECC in the spare area for the pages programmed from now on, by
+// flash_write()
+void flash_set_ecc(uint8_t enable)
+{
+    eccEnabled = enable;
+}
+
+// Spare bytes for a page written with ECC; data past dataLength is 0xFF
+static void build_spare(const uint8_t* TempStorage, uint16_t dataLength, uint8_t* spare)
 {
+    uint8_t ecc[NAND_ECC_BYTES];
+
+    nand_ecc_calculate(TempStorage, dataLength, ecc);
+    memset(spare, 0xFF, D2_SPARE_USED);
+    for (unsigned i = 0; i < NAND_ECC_BYTES; i++)
+        spare[ECC_SPARE_POS[i]] = ecc[i];
+    spare[D2_ECC_MARK_POS] = D2_ECC_MARK;
+}
+
+// Load one page and latch the 0x10 confirm that starts programming it.
+// Returns without waiting on R/B.
+static void issue_program(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page)
+{
+    uint8_t spare[D2_SPARE_USED];
+
+    if (eccEnabled)
+    {
+        build_spare(TempStorage, dataLength, spare);
+    }
+    else
+    {
+        // An unloaded byte keeps the erased 0xFF, so trailing 0xFF bytes and
+        // the rest of a short page are not clocked in at all
+        while (dataLength > 0 && TempStorage[dataLength - 1] == 0xFF)
+            dataLength--;
+    }
+
     GPIOC->BSRR = F_CLE;		   //activate the command latch enable
-    short_delay_us(1);  // CLE setup time
+    delay_ns(D2_tCLS_NS);  // CLE setup time (tCLS)
     write_port(0x80);					       //send read command 0x80 to port p1
     GPIOB->BSRR = (uint32_t)F_WR << 16;		   //write the write command into the flash
-    short_delay_us(1);  // WE pulse width minimum
+    delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
     GPIOB->BSRR = F_WR;   	   //so that write command is intiated
-    short_delay_us(1);  // WE hold time
+    delay_ns(D2_tWH_NS);  // WE hold time (tWH)
     GPIOC->BSRR = (uint32_t)F_CLE << 16;	       //disable command latch enable
 
     write_port(0x00);					       //send address 0x00 to port P1
@@ -91,63 +192,72 @@ void flash_write(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Addre
 	write_port(0x00);					       //send address 0x00 to port P1
 
 	GPIOB->BSRR = (uint32_t)F_WR << 16;  	   //intiate write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(Address_Flash_Page);            //send lower order 8 bit page address to port P1
 
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //intiate write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(Address_Flash_Page >>8);        //send higher order 8 bit page address to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //initiate the write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(0x00);				           //send address 0x00 to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //initiate the write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(0xFF);  				           //intially set the bits of port P1
 	GPIOB->BSRR = (uint32_t)F_ALE << 16;		   //disable address latch enable which indicates the end of write command for flash
-	short_delay_us(1000);					           //wait for some delay
-
+	delay_ns(D2_tADL_NS);  // ALE to data loading (tADL)
 	int x=0;
     for(x = 0;	x<dataLength;	x++)           //if data counter 'x'<	last_page_size then
 	{
 
-		write_port(*TempStorage);                   //fetch the data from the XRAM loction
-		short_delay_us(1);  // Data setup time (20ns)
+		DataBus_Out(*TempStorage);                   //fetch the data from the XRAM loction
+		delay_ns(D2_tDS_NS);  // Data setup time (tDS)
 	   	GPIOB->BSRR = (uint32_t)F_WR << 16;			//enable write signal of flash
-	   	short_delay_us(1);  // WE pulse width minimum (25ns)
+	   	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	   	GPIOB->BSRR = F_WR;			//disable write signal of flash
 	   	TempStorage++;				                //increment the pointer of XRAM
 	}
 
-    if(dataLength < 512)	//if last page size is less than 512 then
+    if (eccEnabled)
     {
-    for(x=0;x<(512-dataLength);x++)//fill the remaining by data 0xFF
-      {
-    	write_port(0xFF);			                //send data 0xFF through port P1
-		GPIOB->BSRR = (uint32_t)F_WR << 16; 			//enable write signal
-		GPIOB->BSRR = F_WR;			//disable write signal
-      }
+        // The spare area follows column 511, so a short page is filled to reach it
+        for (unsigned col = dataLength; col < D2_PAGE_SIZE + D2_SPARE_USED; col++)
+        {
+            DataBus_Out(col < D2_PAGE_SIZE ? 0xFF : spare[col - D2_PAGE_SIZE]);
+            delay_ns(D2_tDS_NS);  // Data setup time (tDS)
+            GPIOB->BSRR = (uint32_t)F_WR << 16;
+            delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
+            GPIOB->BSRR = F_WR;
+        }
     }
 
-    short_delay_us(1000);					                //call delay function
-
     GPIOC->BSRR = F_CLE;				//enable command latch enable
-    short_delay_us(1);  // CLE setup time
+    delay_ns(D2_tCLS_NS);  // CLE setup time (tCLS)
     write_port(0x10);			                    //initiate write command to flash so that the data from flash buffer
 
     GPIOB->BSRR = (uint32_t)F_WR << 16;				//enable write signal of flash
-    short_delay_us(1);  // WE pulse width minimum (25ns)
+    delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
     GPIOB->BSRR = F_WR;   			//disable write signal
     GPIOC->BSRR = (uint32_t)F_CLE << 16; 			//disable command latch enable
-    short_delay_us(1000);					                //call delay function
 }
+
+// 0x00 on success, 0xFF on timeout or if the status reports a failure
+uint8_t flash_write(const uint8_t* TempStorage, uint16_t dataLength, uint16_t Address_Flash_Page,CartridgeID id)
+{
+    issue_program(TempStorage, dataLength, Address_Flash_Page);
+    if (wait_ready(D2_tPROG_MAX_US) != 0x00)        //R/B goes high when the page is programmed
+        return 0xFF;
+    return (read_status() & 0x01) ? 0xFF : 0x00;
+}
+
 //****************************************************************************
 //POST FLASH WRITE
 //****************************************************************************
@@ -168,6 +278,7 @@ void post_write_flash(CartridgeID id)
 void pre_read_flash(CartridgeID id)
 {
 	Configure_GPIO_IO_D2(Output);                             //port P1 is declared as output port
+	Configure_RB_Input();
 
 	GPIOB->BSRR = (uint32_t)F_ALE << 16;		               //disable address latch enable pin of flash
 	GPIOB->BSRR = F_WP;	                   //disable write protect pin of flash
@@ -184,11 +295,10 @@ void flash_read(uint8_t *TempStorage, uint16_t dataLength, uint16_t Address_Flas
 {
 
 	GPIOC->BSRR = F_CLE;			//activate the command latch enable
-	short_delay_us(1);  // CLE setup time
-
+	delay_ns(D2_tCLS_NS);  // CLE setup time (tCLS)
 	write_port(0x00);				            //send read command 0x00 to port p1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;			//write the read command into the flash
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;   		//so that read command is intiated
 
 	GPIOC->BSRR = (uint32_t)F_CLE << 16;		    //diable command latch enable
@@ -196,38 +306,114 @@ void flash_read(uint8_t *TempStorage, uint16_t dataLength, uint16_t Address_Flas
 
 	write_port(0x00);			                //send address 0x00 to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;  		//intiate write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(Address_Flash_Page);             //send lower order 8 bit page address to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;			//intiate write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(Address_Flash_Page >>8);	        //send higher order 8 bit page address to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;			//initiate the write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 
 	write_port(0x00);				            //send address 0x00 to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;			//intiate the write signal
-	short_delay_us(1);  // WE pulse width minimum (25ns)
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
 	GPIOB->BSRR = (uint32_t)F_ALE << 16;			//disable addresss latch enable which indicates
 	write_port(0xFF);				            // the end of of the address write
 	Configure_GPIO_IO_D2(Input);			        //change the mode of port P1 as input port so that the
 	                                            //controller is now ready to recieve data from the port p1
-	short_delay_us(5000);				                //call delay function
+	wait_ready(D2_tR_MAX_US);			            //R/B goes high when the page is in the data register
 	for(uint16_t x = 0;	x<512;	x++)                    //if data counter(x)<512 then
 	{
 		GPIOB->BSRR = (uint32_t)F_RD << 16;		//activate the read enable signal of flash
-		short_delay_us(1);  // RE pulse width minimum (25ns) + data access time
-		*TempStorage = Read_port();
+		delay_ns(D2_tREA_NS);  // RE to data valid (tREA)
+		*TempStorage = DataBus_In();
 		GPIOB->BSRR = F_RD;		//disable read enable
-		short_delay_us(1);  // RE hold time minimum (15ns)
+		delay_ns(D2_tREH_NS);  // RE hold time (tREH)
 		TempStorage++;			                            //increment XRAM pointer by one
 	}
 }
+
+// flash_read() plus a check against the ECC in the spare area, which RE
+// reaches by clocking on past column 511.  A single flipped bit is corrected
+// in the buffer; a page without the ECC marker was written with ECC off and
+// is returned as read.  Returns a NandEccResult.
+uint8_t flash_read_ecc(uint8_t* TempStorage, uint16_t Address_Flash_Page, CartridgeID id)
+{
+    uint8_t spare[D2_SPARE_USED];
+    uint8_t stored[NAND_ECC_BYTES];
+    uint8_t calc[NAND_ECC_BYTES];
+
+    flash_read(TempStorage, D2_PAGE_SIZE, Address_Flash_Page, id);
+    for (uint16_t x = 0; x < D2_SPARE_USED; x++)
+    {
+        GPIOB->BSRR = (uint32_t)F_RD << 16;
+        delay_ns(D2_tREA_NS);  // RE to data valid (tREA)
+        spare[x] = DataBus_In();
+        GPIOB->BSRR = F_RD;
+        delay_ns(D2_tREH_NS);  // RE hold time (tREH)
+    }
+
+    if (spare[D2_ECC_MARK_POS] != D2_ECC_MARK)
+        return NAND_ECC_OK;
+
+    for (unsigned i = 0; i < NAND_ECC_BYTES; i++)
+        stored[i] = spare[ECC_SPARE_POS[i]];
+    nand_ecc_calculate(TempStorage, D2_PAGE_SIZE, calc);
+    return nand_ecc_correct(TempStorage, stored, calc);
+}
+
+// 1 if the buffer is all 0xFF, what an erased page reads.  Compares four
+// words per step once aligned.
+uint8_t flash_page_blank(const uint8_t* buffer, uint16_t dataLength)
+{
+    const uint8_t* end = buffer + dataLength;
+
+    while (((uintptr_t)buffer & 3U) && buffer < end)
+    {
+        if (*buffer++ != 0xFF)
+            return 0;
+    }
+
+    const uint32_t* word = (const uint32_t*)buffer;
+    for (; (const uint8_t*)(word + 4) <= end; word += 4)
+    {
+        if ((word[0] & word[1] & word[2] & word[3]) != 0xFFFFFFFFU)
+            return 0;
+    }
+
+    for (buffer = (const uint8_t*)word; buffer < end; buffer++)
+    {
+        if (*buffer != 0xFF)
+            return 0;
+    }
+    return 1;
+}
+
+// 1 if every page of the block holding Address_Flash_Page reads erased.
+// Between pre_read_flash/pre_erase_flash and the matching post; stops at
+// the first page holding data and leaves the bus as an output.
+uint8_t flash_block_blank(uint16_t Address_Flash_Page, CartridgeID id)
+{
+    uint32_t page[D2_PAGE_SIZE / 4];
+    uint16_t first = Address_Flash_Page & (uint16_t)~(D2_PAGES_PER_BLOCK - 1);
+    uint8_t blank = 1;
+
+    for (uint16_t i = 0; i < D2_PAGES_PER_BLOCK && blank; i++)
+    {
+        Configure_GPIO_IO_D2(Output);               // flash_read leaves it as an input
+        flash_read((uint8_t*)page, D2_PAGE_SIZE, first + i, id);
+        blank = flash_page_blank((const uint8_t*)page, D2_PAGE_SIZE);
+    }
+
+    Configure_GPIO_IO_D2(Output);
+    return blank;
+}
 //****************************************************************************
 //POST_READ_FLASH
 //****************************************************************************
@@ -247,101 +433,41 @@ void post_read_flash(CartridgeID id)
 
 void write_port(uint8_t data)
 {
-	if(data & 0x80) GPIOA->BSRR = M_D7; else GPIOA->BSRR = (uint32_t)M_D7 << 16;
-	if(data & 0x40) GPIOC->BSRR = M_D6; else GPIOC->BSRR = (uint32_t)M_D6 << 16;
-	if(data & 0x20) GPIOA->BSRR = M_D5; else GPIOA->BSRR = (uint32_t)M_D5 << 16;
-	if(data & 0x10) GPIOC->BSRR = M_D4; else GPIOC->BSRR = (uint32_t)M_D4 << 16;
-	if(data & 0x08) GPIOC->BSRR = M_D3; else GPIOC->BSRR = (uint32_t)M_D3 << 16;
-	if(data & 0x04) GPIOD->BSRR = M_D2; else GPIOD->BSRR = (uint32_t)M_D2 << 16;
-	if(data & 0x02) GPIOE->BSRR = M_D1; else GPIOE->BSRR = (uint32_t)M_D1 << 16;
-	if(data & 0x01) GPIOB->BSRR = M_D0; else GPIOB->BSRR = (uint32_t)M_D0 << 16;
+	DataBus_Out(data);
 }
 
 uint8_t Read_port()
 {
-  uint8_t ret =
-  ((GPIOA->IDR & M_D7) ? 0x80 : 0) |
-  ((GPIOC->IDR & M_D6) ? 0x40 : 0) |
-  ((GPIOA->IDR & M_D5) ? 0x20 : 0) |
-  ((GPIOC->IDR & M_D4) ? 0x10 : 0) |
-  ((GPIOC->IDR & M_D3) ? 0x08 : 0) |
-  ((GPIOD->IDR & M_D2) ? 0x04 : 0) |
-  ((GPIOE->IDR & M_D1) ? 0x02 : 0) |
-  ((GPIOB->IDR & M_D0) ? 0x01 : 0);
-
-  return ret;
+  return DataBus_In();
 }
 
 void Configure_GPIO_IO_D2(enum pinConfiuration io)
 {
-	GPIO_InitTypeDef GPIO_InitStruct = {0};
-
-  switch(io)
-  {
-   case 0 :
-
-	   GPIO_InitStruct.Pin = C2DB2_C3DB2_Pin;
-       GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-       GPIO_InitStruct.Pull = GPIO_NOPULL;
-       HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
-
-       GPIO_InitStruct.Pin  = C2DB4_C3DB4_Pin|C2DB3_C3DB3_Pin|C2DB6_C3DB6_Pin;
-       GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-       GPIO_InitStruct.Pull = GPIO_NOPULL;
-       HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
-
-       GPIO_InitStruct.Pin  = C2DB7_C3DB7_INOUT_Pin| C2DB5_C3DB5_INOUT_Pin;
-       GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-       GPIO_InitStruct.Pull = GPIO_NOPULL;
-       HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
-
-       GPIO_InitStruct.Pin  = C2DB1_C3DB1_Pin;
-       GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-       GPIO_InitStruct.Pull = GPIO_NOPULL;
-       HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
-
-       GPIO_InitStruct.Pin  = C2DB0_C3DB0_Pin;
-       GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-       GPIO_InitStruct.Pull = GPIO_NOPULL;
-       HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
-
-
-    break;
-
-   case 1:
-
-	   GPIO_InitStruct.Pin = C2DB2_C3DB2_Pin;
-	   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	   GPIO_InitStruct.Pull = GPIO_NOPULL;
-	   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-	   HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
-
-	   GPIO_InitStruct.Pin  = C2DB4_C3DB4_Pin|C2DB3_C3DB3_Pin|C2DB6_C3DB6_Pin;
-	   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	   GPIO_InitStruct.Pull = GPIO_NOPULL;
-	   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-	   HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
-
-	   GPIO_InitStruct.Pin  = C2DB7_C3DB7_INOUT_Pin| C2DB5_C3DB5_INOUT_Pin;
-	   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	   GPIO_InitStruct.Pull = GPIO_NOPULL;
-	   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-	   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
-
-	   GPIO_InitStruct.Pin  = C2DB1_C3DB1_Pin;
-	   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	   GPIO_InitStruct.Pull = GPIO_NOPULL;
-	   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-	   HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
+  if (io == Output)
+      DataBus_DirOut();
+  else
+      DataBus_DirIn();
+}
 
-	   GPIO_InitStruct.Pin  = C2DB0_C3DB0_Pin;
-	   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
-	   GPIO_InitStruct.Pull = GPIO_NOPULL;
-	   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-	   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+/**
+ * @brief  Core cycles for one output/input turnaround of the data bus
+ * @note   Best of 8 runs, so an interrupt landing in one does not count.
+ *         Leaves the bus an input; call only with every read strobe idle.
+ */
+uint32_t DataBus_TurnaroundCycles(void)
+{
+    uint32_t best = UINT32_MAX;
 
-	   break;
-  }
+    for (int run = 0; run < 8; run++)
+    {
+        uint32_t start = DWT->CYCCNT;
+        DataBus_DirOut();
+        DataBus_DirIn();
+        uint32_t cycles = DWT->CYCCNT - start;
+        if (cycles < best)
+            best = cycles;
+    }
+    return best;
 }
 
 void pre_erase_flash(CartridgeID id)
@@ -355,49 +481,45 @@ void pre_erase_flash(CartridgeID id)
 	GPIOC->BSRR = (uint32_t)F_CLE << 16;	                 //disable command latch enable pin of flash
 	GPIOC->BSRR = (uint32_t)F_CE << 16;		 //activate the flash chip
 
-	GPIO_InitTypeDef GPIO_InitStruct = {0};
-	GPIO_InitStruct.Pin = C2RB0_Pin;
-	GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
-	GPIO_InitStruct.Pull = GPIO_NOPULL;
-	HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+	Configure_RB_Input();
 
 }
 
 unsigned char flash_device_ID(CartridgeID id)
 {
 	GPIOC->BSRR = F_CLE;		   //activate the command latch enable
-	short_delay_us(1000);
+	delay_ns(D2_tCLS_NS);
 	write_port(0x90);					       //send read command 0x80 to port p1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //write the write command into the flash
-	short_delay_us(1000);
+	delay_ns(D2_tWP_NS);
 	GPIOB->BSRR = F_WR;   	   //so that write command is intiated
 	GPIOC->BSRR = (uint32_t)F_CLE << 16;	       //disable command latch enable
-	short_delay_us(1000);
+	delay_ns(D2_tWH_NS);
 
 	GPIOB->BSRR = F_ALE;		   //activate address latch enable signal of flash
-	short_delay_us(1000);
+	delay_ns(D2_tCLS_NS);
 
 	write_port((0x00) & 0xFF);            //send lower order 8 bit page address to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //intiate write signal
-	short_delay_us(1000);
+	delay_ns(D2_tWP_NS);
 	GPIOB->BSRR = F_WR;
 
 	GPIOB->BSRR = (uint32_t)F_ALE << 16;		   //activate address latch enable signal of flash
 
 
 	Configure_GPIO_IO_D2(Input);
-	short_delay_us(1000);
+	delay_ns(D2_tWHR_NS);
 	GPIOB->BSRR = (uint32_t)F_RD << 16;
-	short_delay_us(1000);
+	delay_ns(D2_tREA_NS);
 	unsigned char result = Read_port();
 	GPIOB->BSRR = F_RD;
-	short_delay_us(1000);
+	delay_ns(D2_tREH_NS);
 
 	GPIOB->BSRR = (uint32_t)F_RD << 16;
-	short_delay_us(1000);
+	delay_ns(D2_tREA_NS);
 	result = Read_port();
 	GPIOB->BSRR = F_RD;
-	short_delay_us(1000);
+	delay_ns(D2_tREH_NS);
 
 	return result;
 
@@ -412,69 +534,81 @@ unsigned char flash_erase(uint16_t Address_Flash_Page,CartridgeID id)
 	unsigned char answer;
 
     GPIOC->BSRR = F_CLE;		   //activate the command latch enable
-    short_delay_us(1);  // CLE setup time
+    delay_ns(D2_tCLS_NS);  // CLE setup time (tCLS)
     write_port(0x60);					       //send read command 0x80 to port p1
     GPIOB->BSRR = (uint32_t)F_WR << 16;		   //write the write command into the flash
-    short_delay_us(1);  // WE pulse width minimum (25ns)
+    delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
     GPIOB->BSRR = F_WR;   	   //so that write command is intiated
     GPIOC->BSRR = (uint32_t)F_CLE << 16;	       //disable command latch enable
 
 	GPIOB->BSRR = F_ALE;		   //activate address latch enable signal of flash
-	short_delay_us(1000);
 
 	write_port((Address_Flash_Page) & 0xFF);            //send lower order 8 bit page address to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //intiate write signal
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
-	short_delay_us(1000);
 
 	write_port((Address_Flash_Page >>8) & 0xFF);        //send higher order 8 bit page address to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //initiate the write signal
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
-	short_delay_us(1000);
 
 	write_port(0x00);				           //send address 0x00 to port P1
 	GPIOB->BSRR = (uint32_t)F_WR << 16;		   //initiate the write signal
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
 	GPIOB->BSRR = F_WR;
-	short_delay_us(1000);
 
 	GPIOB->BSRR = (uint32_t)F_ALE << 16;
 
 
 	GPIOC->BSRR = F_CLE;
-	short_delay_us(1000);
 	write_port(0xD0);
 	GPIOB->BSRR = (uint32_t)F_WR << 16;
+	delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
     GPIOB->BSRR = F_WR;
     GPIOC->BSRR = (uint32_t)F_CLE << 16;
-    short_delay_us(1000);
 
-    //rdy
-    while((GPIOA->IDR & F_RDY) == 0);
+    //rdy - bounded by the datasheet block erase time
+    if(wait_ready(D2_tBERS_MAX_US) != 0x00)
+    {
+        return 0xFF;  // timeout error
+    }
+
+    result = read_status();
+
+    if((result & 0x01)==0x01)
+    {
+       answer = 0xFF; //error
+    }
+    else
+    {
+      answer = 0x00; //success
+    }
+    return answer;
+}
+
+// Status register of the selected chip; bit 0 set if the last program or
+// erase failed.  Leaves the bus as an output.
+static uint8_t read_status(void)
+{
+    uint8_t result;
 
     write_port(0x70);
-    short_delay_us(1000);
     GPIOC->BSRR = F_CLE;
+    delay_ns(D2_tCLS_NS);  // CLE setup time (tCLS)
     GPIOB->BSRR = (uint32_t)F_WR << 16;
-    short_delay_us(1000);
+    delay_ns(D2_tWP_NS);  // WE pulse width (tWP)
     GPIOB->BSRR = F_WR;
     GPIOC->BSRR = (uint32_t)F_CLE << 16;
 
     Configure_GPIO_IO_D2(Input);
     GPIOB->BSRR = (uint32_t)F_RD << 16;
-    short_delay_us(1000);
+    delay_ns(D2_tREA_NS);  // RE to data valid (tREA)
     result = Read_port();
     GPIOB->BSRR = F_RD;
     Configure_GPIO_IO_D2(Output);
 
-    if((result & 0x01)==0x01)
-    {
-       answer = 0xFF; //error
-    }
-    else
-    {
-      answer = 0x00; //success
-    }
-    return answer;
+    return result;
 }
 
 void post_erase_flash(CartridgeID id)			 //function deactivate control lines of flash
@@ -550,9 +684,3 @@ void UpdateD2SlotStatus()
 			SLT_STATUS[0] = 0x00;SLT_STATUS[1] = 0x00;SLT_STATUS[2] = 0x00;SLT_STATUS[3] = 0x00;
 		}
 }
-
-void short_delay_us(uint32_t us) {
-    for (volatile uint32_t i = 0; i < us * 8; i++) {
-        __NOP();  // One NOP ~1 cycle
-    }
-}
@@ -33,10 +33,22 @@ extern "C" {
  * @brief Core NAND flash operations for read, write, and erase
  * @{
  */
-void flash_write(const uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress, CartridgeID id);
+uint8_t flash_write(const uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress, CartridgeID id);
 void flash_read(uint8_t* buffer, uint16_t dataLength, uint16_t pageAddress, CartridgeID id);
 unsigned char flash_erase(uint16_t pageAddress, CartridgeID id);
 uint8_t flash_device_ID(CartridgeID id);
+uint8_t flash_page_blank(const uint8_t* buffer, uint16_t dataLength);
+uint8_t flash_block_blank(uint16_t pageAddress, CartridgeID id);
+/**
+ * @}
+ */
+
+/** @defgroup DARIN2_FLASH_Ecc Spare Area ECC
+ * @brief Hamming ECC (NandEcc.h) written with each page and checked on read
+ * @{
+ */
+void flash_set_ecc(uint8_t enable);
+uint8_t flash_read_ecc(uint8_t* buffer, uint16_t pageAddress, CartridgeID id);
 /**
  * @}
  */
@@ -60,9 +72,9 @@ void post_erase_flash(CartridgeID id);
  * @{
  */
 void Configure_GPIO_IO_D2(enum pinConfiuration io);
+uint32_t DataBus_TurnaroundCycles(void);
 uint8_t Read_port(void);
 void write_port(uint8_t data);
-void short_delay_us(uint32_t us);
 /**
  * @}
  */
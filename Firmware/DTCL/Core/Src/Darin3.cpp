@@ -85,6 +85,13 @@ uint32_t Darin3::prepareForRx(const uint8_t* data,
 }
 
 
+// File data goes out a sector at a time while the rest of a transfer is
+// still arriving; the write stream takes it in any split
+uint32_t Darin3::rxWriteStep(uint8_t subcmd)
+{
+    return 512;
+}
+
 uint8_t Darin3::processRxData(const uint8_t* data,
                               const uint8_t  subcmd,
                               uint32_t       len)
@@ -8,6 +8,7 @@
 #include "stm32f4xx_hal.h"
 #include "main.h"
 #include "Darin3Cart_Driver.h"
+#include "Timing.h"
 
 uint16_t CF_WE  = C3WE_Pin;
 uint16_t CF_RST = C3RST_Pin;
@@ -34,6 +35,9 @@ static uint8_t SLT_STATUS2[] = { 0, 0, 0, 0 };
 #define drive          0x06
 #define command        0x07
 #define status_reg     0x07
+
+/* LED blink half-period */
+#define LED_BLINK_MS   160U
 //****************************************************************************
 //****************************************************************************
 // COMPACT FLASH READ OPERATION
@@ -59,9 +63,9 @@ void pre_read_compact_flash(CartridgeID id)//function to pre intialise the ports
  HAL_GPIO_WritePin(GPIOA,CF_OE,1);				//disable output enable of compact flash
  HAL_GPIO_WritePin(GPIOB,CF_CE,0);
  HAL_GPIO_WritePin(GPIOE,CF_RST,1);				//Enable reset
- short_delay_us(500);
+ delay_us(500);
  HAL_GPIO_WritePin(GPIOE,CF_RST,0);				//disable reset
- short_delay_us(2500);
+ delay_us(2500);
 }
 //****************************************************************************
 //COMMAND_FOR _READ
@@ -93,7 +97,7 @@ void command_for_read()						 //function to intiate read command for compact fla
  write_port(0x20);								 //send the command value from which you want to read the data
  HAL_GPIO_WritePin(GPIOC, CF_WE, 0);			 //intiate the write signal
  HAL_GPIO_WritePin(GPIOC, CF_WE, 1);
- short_delay_us(50);									 //call delay function
+ delay_us(50);									 //call delay function
  Configure_GPIO_IO_D2(Input);					 //set the mode of port p1 as input port
 }
 //****************************************************************************
@@ -148,9 +152,9 @@ void pre_write_compact_flash(CartridgeID id)              //this function initia
  HAL_GPIO_WritePin(GPIOA,CF_OE,1);				//disable output enable of compact flash
  HAL_GPIO_WritePin(GPIOB,CF_CE,0);
  HAL_GPIO_WritePin(GPIOE,CF_RST,1);				//Enable reset
- short_delay_us(50);
+ delay_us(50);
  HAL_GPIO_WritePin(GPIOE,CF_RST,0);				//disable reset
- short_delay_us(2500);
+ delay_us(2500);
 }
 //****************************************************************************
 //COMPACT_FLASH_READY
@@ -159,7 +163,7 @@ unsigned char compact_flash_ready()         //function to find wheather the comp
 {
  unsigned char reg_status;
  write_address_port(status_reg);                //send 0x07 to CF so that select status register of CF
- short_delay_us(50);			                        //call delay function
+ delay_us(50);			                        //call delay function
  unsigned int BusyCnt;
 
  BusyCnt = 0;
@@ -229,7 +233,7 @@ unsigned char check_stat_of_compact_flash()	//function to check wheather the com
 {
  unsigned char reg_status;
  write_address_port(status_reg);				//address the register pointer to point to status regester
- short_delay_us(50);								    //wait for some delay //if error then quit
+ delay_us(50);								    //wait for some delay //if error then quit
  unsigned int BusyCnt;
 
  BusyCnt = 0;
@@ -286,7 +290,7 @@ void compact_flash_write(uint8_t* TempStorage,uint16_t datalength)	//if command
  unsigned char busy;
  Configure_GPIO_IO_D2(Output);				//set the mode of port p1 as output port
  write_address_port(data_reg);				//address the register pointer to point to data regester
- short_delay_us(50);
+ delay_us(50);
  for (uint16_t x=0 ;x<datalength ;x++)      //if data counter value <last page size then
  {
   write_port(*TempStorage) ;			    //read the data from XRAM location load it into the CF
@@ -429,12 +433,12 @@ uint8_t LedLoopBack(uint8_t value)
         if(GPIOE->IDR & LED4_LOOPBACK_Pin)
             data = data | 0x02;
   
-        short_delay_us(500000);
+        delay_ms(LED_BLINK_MS);
 
         HAL_GPIO_WritePin(GPIOB, LED1_Pin, 0x00);
         HAL_GPIO_WritePin(GPIOB, LED2_Pin, 0x00);
 
-        short_delay_us(500000);
+        delay_ms(LED_BLINK_MS);
 
         if(GPIOE->IDR & LED1_LOOPBACK_Pin)
             data2 = data2 | 0x01;
@@ -0,0 +1,136 @@
+/**
+ ******************************************************************************
+ * @file    DataBus.h
+ * @brief   Byte-wide access to the cartridge data bus for DTCL
+ ******************************************************************************
+ * @attention
+ *
+ * Copyright (c) 2023-2024 ISquare Systems
+ * All rights reserved.
+ *
+ * This software is licensed under terms that can be found in the LICENSE file
+ * in the root directory of this software component.
+ * If no LICENSE file comes with this software, it is provided AS-IS.
+ *
+ ******************************************************************************
+ */
+
+#ifndef DATABUS_H
+#define DATABUS_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* The Darin-II and Darin-III data lines are shared and spread over five
+ * ports:
+ *   D7 PA2   D6 PC5   D5 PA1   D4 PC4   D3 PC3   D2 PD9   D1 PE14   D0 PB15
+ * so a byte takes one BSRR store and one IDR load per port rather than one
+ * access per bit. */
+#define DATABUS_PA_MASK  (C2DB7_C3DB7_INOUT_Pin | C2DB5_C3DB5_INOUT_Pin)
+#define DATABUS_PC_MASK  (C2DB6_C3DB6_Pin | C2DB4_C3DB4_Pin | C2DB3_C3DB3_Pin)
+
+/**
+ * @brief  Drive a byte onto the data bus
+ * @note   Each store resets the port's data lines and sets the 1 bits at
+ *         once; where both are requested BSRR gives the set bit priority.
+ */
+static inline void DataBus_Out(uint8_t data)
+{
+    GPIOA->BSRR = ((uint32_t)DATABUS_PA_MASK << 16)
+                | ((data & 0x80) ? C2DB7_C3DB7_INOUT_Pin : 0)
+                | ((data & 0x20) ? C2DB5_C3DB5_INOUT_Pin : 0);
+    GPIOC->BSRR = ((uint32_t)DATABUS_PC_MASK << 16)
+                | ((data & 0x40) ? C2DB6_C3DB6_Pin : 0)
+                | ((data & 0x10) ? C2DB4_C3DB4_Pin : 0)
+                | ((data & 0x08) ? C2DB3_C3DB3_Pin : 0);
+    GPIOD->BSRR = (data & 0x04) ? C2DB2_C3DB2_Pin : ((uint32_t)C2DB2_C3DB2_Pin << 16);
+    GPIOE->BSRR = (data & 0x02) ? C2DB1_C3DB1_Pin : ((uint32_t)C2DB1_C3DB1_Pin << 16);
+    GPIOB->BSRR = (data & 0x01) ? C2DB0_C3DB0_Pin : ((uint32_t)C2DB0_C3DB0_Pin << 16);
+}
+
+/**
+ * @brief  Sample the data bus
+ */
+static inline uint8_t DataBus_In(void)
+{
+    uint32_t pa = GPIOA->IDR;
+    uint32_t pc = GPIOC->IDR;
+
+    return ((pa & C2DB7_C3DB7_INOUT_Pin) ? 0x80 : 0) |
+           ((pc & C2DB6_C3DB6_Pin)       ? 0x40 : 0) |
+           ((pa & C2DB5_C3DB5_INOUT_Pin) ? 0x20 : 0) |
+           ((pc & C2DB4_C3DB4_Pin)       ? 0x10 : 0) |
+           ((pc & C2DB3_C3DB3_Pin)       ? 0x08 : 0) |
+           ((GPIOD->IDR & C2DB2_C3DB2_Pin) ? 0x04 : 0) |
+           ((GPIOE->IDR & C2DB1_C3DB1_Pin) ? 0x02 : 0) |
+           ((GPIOB->IDR & C2DB0_C3DB0_Pin) ? 0x01 : 0);
+}
+
+/* MODER pattern 01 (general purpose output) for a single pin: the 2-bit
+ * field of pin n starts at bit 2n, and (1 << n)^2 == 1 << 2n */
+#define DATABUS_MODER_OUT(pin)  ((uint32_t)(pin) * (uint32_t)(pin))
+
+#define DATABUS_PA_MODER_OUT  (DATABUS_MODER_OUT(C2DB7_C3DB7_INOUT_Pin) | DATABUS_MODER_OUT(C2DB5_C3DB5_INOUT_Pin))
+#define DATABUS_PC_MODER_OUT  (DATABUS_MODER_OUT(C2DB6_C3DB6_Pin) | DATABUS_MODER_OUT(C2DB4_C3DB4_Pin) | \
+                               DATABUS_MODER_OUT(C2DB3_C3DB3_Pin))
+#define DATABUS_PD_MODER_OUT  DATABUS_MODER_OUT(C2DB2_C3DB2_Pin)
+#define DATABUS_PE_MODER_OUT  DATABUS_MODER_OUT(C2DB1_C3DB1_Pin)
+#define DATABUS_PB_MODER_OUT  DATABUS_MODER_OUT(C2DB0_C3DB0_Pin)
+
+/* The whole 2-bit field of the same pins */
+#define DATABUS_MODER_FIELD(out)  ((out) * 3U)
+
+static inline void DataBus_SetModer(GPIO_TypeDef* port, uint32_t out, uint8_t output)
+{
+    port->MODER = (port->MODER & ~DATABUS_MODER_FIELD(out)) | (output ? out : 0U);
+}
+
+/**
+ * @brief  One-time pad setup: push-pull, low speed, no pull
+ * @note   Call after MX_GPIO_Init(). Direction changes afterwards only
+ *         rewrite MODER.
+ */
+static inline void DataBus_Init(void)
+{
+    GPIOA->OTYPER &= ~(uint32_t)DATABUS_PA_MASK;
+    GPIOC->OTYPER &= ~(uint32_t)DATABUS_PC_MASK;
+    GPIOD->OTYPER &= ~(uint32_t)C2DB2_C3DB2_Pin;
+    GPIOE->OTYPER &= ~(uint32_t)C2DB1_C3DB1_Pin;
+    GPIOB->OTYPER &= ~(uint32_t)C2DB0_C3DB0_Pin;
+
+    GPIOA->OSPEEDR &= ~DATABUS_MODER_FIELD(DATABUS_PA_MODER_OUT);
+    GPIOC->OSPEEDR &= ~DATABUS_MODER_FIELD(DATABUS_PC_MODER_OUT);
+    GPIOD->OSPEEDR &= ~DATABUS_MODER_FIELD(DATABUS_PD_MODER_OUT);
+    GPIOE->OSPEEDR &= ~DATABUS_MODER_FIELD(DATABUS_PE_MODER_OUT);
+    GPIOB->OSPEEDR &= ~DATABUS_MODER_FIELD(DATABUS_PB_MODER_OUT);
+
+    GPIOA->PUPDR &= ~DATABUS_MODER_FIELD(DATABUS_PA_MODER_OUT);
+    GPIOC->PUPDR &= ~DATABUS_MODER_FIELD(DATABUS_PC_MODER_OUT);
+    GPIOD->PUPDR &= ~DATABUS_MODER_FIELD(DATABUS_PD_MODER_OUT);
+    GPIOE->PUPDR &= ~DATABUS_MODER_FIELD(DATABUS_PE_MODER_OUT);
+    GPIOB->PUPDR &= ~DATABUS_MODER_FIELD(DATABUS_PB_MODER_OUT);
+}
+
+/**
+ * @brief  Turn the data bus around: one read-modify-write of MODER per port
+ */
+static inline void DataBus_SetDir(uint8_t output)
+{
+    DataBus_SetModer(GPIOA, DATABUS_PA_MODER_OUT, output);
+    DataBus_SetModer(GPIOC, DATABUS_PC_MODER_OUT, output);
+    DataBus_SetModer(GPIOD, DATABUS_PD_MODER_OUT, output);
+    DataBus_SetModer(GPIOE, DATABUS_PE_MODER_OUT, output);
+    DataBus_SetModer(GPIOB, DATABUS_PB_MODER_OUT, output);
+}
+
+static inline void DataBus_DirOut(void)
+{
+    DataBus_SetDir(1);
+}
+
+static inline void DataBus_DirIn(void)
+{
+    DataBus_SetDir(0);
+}
+
+#endif /* DATABUS_H */
@@ -2,6 +2,7 @@
 #include "diskio.h"
 #include "main.h"
 #include "../Darin3Cart_Driver.h"
+#include "../Timing.h"
 #include "stm32f4xx_hal.h"
 #include <stdlib.h>
 
@@ -204,7 +205,7 @@ unsigned char ChkCFRdyForCmd(void)
   
   write_address_port(STATUS_REG);			 //address the register pointer to point to status regester
   HAL_GPIO_WritePin(GPIOA, CF_OE1, 0);		 //intiate read signal
-  short_delay_us(50);								 //wait for some delay
+  delay_us(50);								 //wait for some delay
 
   RdStatus = Read_port();
   RdStatus = RdStatus & 0x01;
@@ -241,7 +242,7 @@ unsigned char ChkCFRdyForData(void)
   
   write_address_port(STATUS_REG);			 //address the register pointer to point to status regester
   HAL_GPIO_WritePin(GPIOA, CF_OE1, 0);		 //intiate read signal
-  short_delay_us(50);								 //wait for some delay
+  delay_us(50);								 //wait for some delay
 
   RdStatus = Read_port();
 
@@ -295,9 +296,9 @@ void RstCf(void)
 	//TODO: To be implemented
    //IOWR_32DIRECT(CFNRST_BASE,0x00,0x00000000);
    HAL_GPIO_WritePin(GPIOA, C3_PWR_CYCLE_Pin, 0);
-   short_delay_us(1000);
+   delay_ms(1);
    HAL_GPIO_WritePin(GPIOA, C3_PWR_CYCLE_Pin, 1);
-   short_delay_us(1000);
+   delay_ms(1);
    //IOWR_32DIRECT(CFNRST_BASE,0x00,0xFFFFFFFF);
    //Delay(1000,1000);
 }
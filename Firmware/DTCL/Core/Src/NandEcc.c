@@ -0,0 +1,150 @@
+/**
+ ******************************************************************************
+ * @file    NandEcc.c
+ * @brief   Hamming ECC for 512-byte NAND pages (1-bit correct, 2-bit detect)
+ ******************************************************************************
+ * @attention
+ *
+ * Copyright (c) 2023-2024 ISquare Systems
+ * All rights reserved.
+ *
+ * This software is licensed under terms that can be found in the LICENSE file
+ * in the root directory of this software component.
+ * If no LICENSE file comes with this software, it is provided AS-IS.
+ *
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "NandEcc.h"
+#include <string.h>
+
+/* Private Constants ---------------------------------------------------------*/
+#define ECC_HALF_SIZE   256U
+
+/* Indexed by a 4-bit mask of the odd-parity byte lanes of a word (lane n =
+ * byte n of the little-endian word): whether an odd number of lanes is set,
+ * and the XOR of the lane numbers that are.  The nibble table doubles as a
+ * parity lookup. */
+static const uint8_t ODD_COUNT[16] = { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 };
+static const uint8_t ODD_LANES[16] = { 0, 0, 1, 1, 2, 2, 3, 3, 3, 3, 2, 2, 1, 1, 0, 0 };
+
+/* Private Functions ---------------------------------------------------------*/
+
+static inline uint8_t parity8(uint8_t x)
+{
+    return ODD_COUNT[x & 0x0F] ^ ODD_COUNT[x >> 4];
+}
+
+/* Word at offset of a page cut short at dataLength; missing bytes read as
+ * 0xFF, as they would from the flash */
+static inline uint32_t load_word(const uint8_t* data, uint16_t offset, uint16_t dataLength)
+{
+    uint32_t word = 0xFFFFFFFFU;
+
+    if (offset + 4U <= dataLength)
+        memcpy(&word, &data[offset], 4);    // single LDR; M4 allows it unaligned
+    else if (offset < dataLength)
+        memcpy(&word, &data[offset], dataLength - offset);
+    return word;
+}
+
+/**
+ * @brief  ECC of one 256-byte half
+ * @note   One pass of 64 words. The column parities come from the XOR of
+ *         every byte; the line parity is the XOR of the indices of the bytes
+ *         with odd parity, found a word at a time through ODD_COUNT/ODD_LANES.
+ */
+static void ecc_half(const uint8_t* data, uint16_t dataLength, uint8_t* ecc)
+{
+    uint32_t column = 0;
+    uint32_t line = 0;
+
+    for (uint16_t offset = 0; offset < ECC_HALF_SIZE; offset += 4)
+    {
+        uint32_t word = load_word(data, offset, dataLength);
+        column ^= word;
+
+        // Bit 0 of each byte lane becomes the parity of that lane
+        uint32_t t = word ^ (word >> 4);
+        t ^= t >> 2;
+        t ^= t >> 1;
+        uint8_t lanes = (uint8_t)((t & 1U) | ((t >> 7) & 2U) | ((t >> 14) & 4U) | ((t >> 21) & 8U));
+
+        line ^= (offset * ODD_COUNT[lanes]) ^ ODD_LANES[lanes];
+    }
+
+    column ^= column >> 16;
+    column ^= column >> 8;
+    uint8_t all = (uint8_t)column;
+
+    uint8_t odd  = (uint8_t)line;                           // bytes with index bit n set
+    uint8_t even = parity8(all) ? (uint8_t)~odd : odd;      // bytes with index bit n clear
+    uint8_t cp   = (uint8_t)((parity8(all & 0xF0) << 7) | (parity8(all & 0x0F) << 6) |
+                             (parity8(all & 0xCC) << 5) | (parity8(all & 0x33) << 4) |
+                             (parity8(all & 0xAA) << 3) | (parity8(all & 0x55) << 2));
+
+    ecc[0] = (uint8_t)~odd;
+    ecc[1] = (uint8_t)~even;
+    ecc[2] = (uint8_t)~cp;
+}
+
+/* Public Functions ----------------------------------------------------------*/
+
+/**
+ * @brief  Compute the ECC of a page
+ * @param  data: Page data
+ * @param  dataLength: Bytes in data; the rest of the page counts as 0xFF
+ * @param  ecc: NAND_ECC_BYTES of output
+ * @retval None
+ */
+void nand_ecc_calculate(const uint8_t* data, uint16_t dataLength, uint8_t* ecc)
+{
+    uint16_t second = (dataLength > ECC_HALF_SIZE) ? (uint16_t)(dataLength - ECC_HALF_SIZE) : 0;
+
+    ecc_half(data, (dataLength < ECC_HALF_SIZE) ? dataLength : ECC_HALF_SIZE, &ecc[0]);
+    ecc_half(data + ECC_HALF_SIZE, second, &ecc[3]);
+}
+
+/**
+ * @brief  Check a page read back against the ECC stored with it
+ * @note   A single flipped data bit is corrected in place.
+ * @param  data: NAND_ECC_PAGE_SIZE bytes as read
+ * @param  stored: ECC from the spare area
+ * @param  calc: ECC of data from nand_ecc_calculate()
+ * @retval Worst result of the two halves
+ */
+NandEccResult nand_ecc_correct(uint8_t* data, const uint8_t* stored, const uint8_t* calc)
+{
+    NandEccResult result = NAND_ECC_OK;
+
+    for (uint16_t half = 0; half < 2; half++)
+    {
+        uint8_t d0 = stored[3 * half]     ^ calc[3 * half];
+        uint8_t d1 = stored[3 * half + 1] ^ calc[3 * half + 1];
+        uint8_t d2 = stored[3 * half + 2] ^ calc[3 * half + 2];
+
+        uint32_t diff = d0 | ((uint32_t)d1 << 8) | ((uint32_t)d2 << 16);
+        if (diff == 0)
+            continue;
+
+        if ((uint8_t)(d0 ^ d1) == 0xFF && ((d2 ^ (d2 >> 1)) & 0x54) == 0x54)
+        {
+            // Every parity pair disagrees: one data bit, at byte d0
+            uint8_t bit = (uint8_t)(((d2 >> 3) & 1U) | ((d2 >> 4) & 2U) | ((d2 >> 5) & 4U));
+            data[half * ECC_HALF_SIZE + d0] ^= (uint8_t)(1U << bit);
+            result = NAND_ECC_CORRECTED;
+        }
+        else if ((diff & (diff - 1)) == 0)
+        {
+            // A single bit of the ECC itself; the data is good
+            if (result == NAND_ECC_OK)
+                result = NAND_ECC_CORRECTED;
+        }
+        else
+        {
+            return NAND_ECC_UNCORRECTABLE;
+        }
+    }
+    return result;
+}
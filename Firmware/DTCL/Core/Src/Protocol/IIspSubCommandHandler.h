@@ -37,6 +37,14 @@ public:
 
     virtual IspSubCommand getSubCmd(){return IspSubCommand::BOARD_ID;};
 
+    // Multi-slot subcommands fill one IspReturnCodes value per slot for
+    // ACK_DONE and return ISP_MAX_SLOTS; everything else reports none
+    virtual uint8_t getSlotResults(uint8_t* codes) {return 0;};
+
+    // Bytes processRxData can take per call when a full receive buffer half
+    // is written out in steps, e.g. one sector; 0 means the half in one call
+    virtual uint32_t rxWriteStep(uint8_t subcmd) {return 0;};
+
     virtual uint16_t processCmdReq(uint8_t* data) {return 0;};
 
 
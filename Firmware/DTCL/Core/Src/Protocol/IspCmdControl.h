@@ -3,6 +3,7 @@
 #include "IspCmdReceiveData.h"
 #include "IspCmdTransmitData.h"
 #include "IspSubCommandProcessor.h"
+#include "IspProtocolDefs.h"
 #include "../Darin3Cart_Driver.h"
 
 enum class IspHostState : uint8_t {
@@ -34,8 +35,12 @@ public:
     void registerSubCmdHandlers(IIspSubCommandHandler* handler);
 
 private:
-    IIspSubCommandHandler* findHandler(IspSubCommand subCmd);
+    IIspSubCommandHandler* findHandler(IspSubCommand subCmd) {
+        uint8_t idx = dispatch[static_cast<uint8_t>(subCmd)];
+        return (idx != ISP_NO_HANDLER) ? subCmdHandlerList[idx].handler : nullptr;
+    }
     IspSubCommandProcessor* processor;
     ControlHandlerEntry subCmdHandlerList[MAX_CONTROL_HANDLERS];
     uint8_t handlerCount;
+    uint8_t dispatch[256];   // subcommand byte -> subCmdHandlerList index
 };
@@ -14,6 +14,7 @@ extern "C" {
 #include "IspCommandHandler.h"
 #include "IspSubCommandProcessor.h"
 #include "IspProtocolDefs.h"
+#include "safeBuffer.h"
 #include <stdint.h>
 
 class IspCmdReceiveData : public IspCommandHandler {
@@ -22,6 +23,7 @@ public:
     void setSubProcessor(IspSubCommandProcessor* proc);
     bool match(uint8_t cmd) override;
     void execute(uint8_t* data, uint32_t len) override;
+    void tick() override;
 
     bool isReceiving() const { return currentState == State::RECEIVING; }
     void reset();
@@ -36,14 +38,54 @@ private:
     uint8_t subCommand;
     IspReturnCodes retCode;
 
+    // Sliding-window mode (negotiated with RX_DATA_WINDOWED).  Bit i of
+    // oooMask marks chunk expectedSeq+i as already stored out of order at
+    // rxBuffer[receivedSize + i*chunkSize]; only the last chunk of
+    // a transfer may be shorter than chunkSize.
+    bool windowed;
+    uint8_t windowSize;
+    uint8_t ackEvery;
+    uint16_t chunkSize;      // full chunk length for the frame format in use
+    uint16_t ackedSeq;       // expectedSeq when the last cumulative ACK was sent
+    uint16_t nextUnseenSeq;  // lowest seq not yet seen or NACKed
+    uint32_t oooMask;
+
+    // ACK_BATCH mode replaces the per-chunk ACKs and gap NACKs with one
+    // bitmap reply, sent on the same cadence or after a short idle period
+    bool ackBatch;
+    bool batchPending;       // something to report since the last ACK_BATCH
+    uint32_t lastChunkTime;
+
+    // rxBuffer holds two MAX_BUF_SIZE halves.  receivedSize counts from the
+    // start of fillHalf; data past its end lands straight in the other half,
+    // so a full half is handed on without moving anything.  A full half is
+    // written to the cartridge from tick(), writeStep bytes per call, while
+    // the host streams into the other one; flushPending marks the previous
+    // half as not yet fully written and flushCursor how far it has got.
+    uint8_t fillHalf;
+    bool flushPending;
+    uint32_t flushCursor;
+    uint32_t writeStep;      // from the handler's rxWriteStep(), MAX_BUF_SIZE if it has none
+    uint8_t flushResult;     // OR of the deferred write results, reported in ACK_DONE
+
     IspSubCommandProcessor* processor;
 
+    uint8_t* fillBuffer() { return &rxBuffer[fillHalf * MAX_BUF_SIZE]; }
+    bool storeChunk(uint32_t pos, const uint8_t* chunk, uint16_t len);
+    void flushFullHalves();
+    void writePendingStep();
+    void writePendingHalf();
+
 
     void sendAck(uint16_t seq, IspReturnCodes retCode);
     void sendNack(uint16_t seq, IspReturnCodes retCode);
-    void sendDoneAck(IspReturnCodes retCode);
+    void sendDoneAck(IspReturnCodes retCode, const uint8_t* slotCodes = nullptr, uint8_t slots = 0);
+    IspReturnCodes collectSlotResults(uint8_t res, uint8_t* slotCodes, uint8_t& slots);
+    void sendAckBatch();
     void handleStartCommand(const uint8_t* data, uint32_t len);
     void handleDataChunk(const uint8_t* data, uint32_t len);
+    void handleWindowedChunk(const uint8_t* data, uint32_t len);
+    void finishTransfer();
     void sendRXAck(uint8_t subcmd);
     void sendRXNack(uint8_t subcmd, IspReturnCodes code);
 };
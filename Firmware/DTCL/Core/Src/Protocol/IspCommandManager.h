@@ -30,6 +30,24 @@ private:
     IspCommandHandler* handlers[MAX_COMMAND_HANDLERS];
     uint8_t handlerCount;
     IspBoardId boardId;
+
+    // Built from match() as handlers are added; the first handler to claim a
+    // byte keeps it, as with the old linear scan
+    uint8_t dispatch[256];
+};
+
+#ifdef STM32F411xE
+// DWT cycles handleData() takes for frames that reach no handler, so only
+// the table lookups are counted; reported by DISPATCH_BENCHMARK.
+// controlCycles covers a CMD_REQ with an unregistered subcommand (command
+// and control tables), unclaimedCycles a command byte nobody claims.
+struct IspDispatchBenchResult {
+    uint32_t frames;
+    uint32_t controlCycles;
+    uint32_t unclaimedCycles;
 };
 
+void IspDispatch_Benchmark(IspCommandManager& mgr, IspDispatchBenchResult& result);
+#endif
+
 #endif // __cplusplus
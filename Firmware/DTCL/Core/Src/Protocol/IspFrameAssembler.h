@@ -0,0 +1,43 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C-compatible section (leave empty if needed)
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+#pragma once
+#include "IspFramingUtils.h"
+#include "safeBuffer.h"
+#include <cstdint>
+#include <cstddef>
+
+// Collects ISP frames from 64-byte USB OUT packets.  A v1 frame always fits
+// in one packet and is handed on without copying; a large (v2) frame is
+// gathered here until its length field is satisfied.
+class IspFrameAssembler {
+public:
+    typedef void (*FrameHandler)(const uint8_t* frame, std::size_t frameLen);
+
+    IspFrameAssembler();
+    void setFrameHandler(FrameHandler fn) { handler = fn; }
+
+    // Feed one USB packet; complete frames are passed to the frame handler
+    void push(const uint8_t* data, std::size_t len, uint32_t nowMs);
+    void reset() { fill = 0; }
+
+private:
+    static constexpr std::size_t MAX_FRAME = ISP_MAX_FRAME_PAYLOAD + IspFramingUtils::MAX_OVERHEAD;
+    static constexpr uint32_t PARTIAL_TIMEOUT_MS = 100;   // drop a frame the host stopped sending
+
+    uint8_t frame[MAX_FRAME];
+    std::size_t fill;
+    uint32_t lastPushMs;
+    FrameHandler handler;
+};
+
+#endif // __cplusplus
@@ -0,0 +1,49 @@
+#include "IspPacketQueue.h"
+#include <atomic>
+#include <cstring>
+
+IspPacketQueue::IspPacketQueue() : head(0), tail(0), maxDepth(0), drops(0) {
+}
+
+bool IspPacketQueue::commit(const uint8_t* data, uint16_t len)
+{
+    if (!canReceive() || len > SLOT_SIZE) {
+        drops++;
+        return false;
+    }
+
+    Slot& slot = slots[head & (SLOTS - 1)];
+    // Normally the packet was received into this slot already; only a packet
+    // that landed elsewhere (the first one after enumeration) is copied
+    if (data != slot.data) {
+        memcpy(slot.data, data, len);
+    }
+    slot.len = len;
+
+    // Publish the slot contents before the new head
+    std::atomic_signal_fence(std::memory_order_release);
+    head = head + 1;
+
+    uint16_t depth = (uint16_t)(head - tail);
+    if (depth > maxDepth) maxDepth = depth;
+    return true;
+}
+
+bool IspPacketQueue::front(const uint8_t*& data, uint16_t& len) const
+{
+    if (head == tail) return false;
+    std::atomic_signal_fence(std::memory_order_acquire);
+
+    const Slot& slot = slots[tail & (SLOTS - 1)];
+    data = slot.data;
+    len  = slot.len;
+    return true;
+}
+
+void IspPacketQueue::pop()
+{
+    if (head == tail) return;
+    // Finish reading the slot before handing it back to the ISR
+    std::atomic_signal_fence(std::memory_order_release);
+    tail = tail + 1;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "IspProtocolDefs.h"
+#include "IspFramingUtils.h"
+#include "IspTransportInterface.h"
+#include "main.h"
+#include <cstdint>
+
+// Unsolicited PROGRESS frames for subcommands that keep the device busy for
+// seconds (cartridge copy, compare and full erase):
+//   [PROGRESS][subcmd][done 4B BE][total 4B BE]
+// update() sends at most one frame per ISP_PROGRESS_INTERVAL_MS; finish()
+// always sends the last one.  A frame the transport cannot take is dropped.
+class IspProgress {
+public:
+    static void setTransport(IspTransportInterface* iface) { state().transport = iface; }
+
+    static void begin(uint8_t subCmd, uint32_t total) {
+        State& s = state();
+        s.subCmd   = subCmd;
+        s.total    = total;
+        s.lastSent = HAL_GetTick();
+        send(0);
+    }
+
+    static void update(uint32_t done) {
+        State& s = state();
+        if ((HAL_GetTick() - s.lastSent) < ISP_PROGRESS_INTERVAL_MS) return;
+        s.lastSent = HAL_GetTick();
+        send(done);
+    }
+
+    static void finish() { send(state().total); }
+
+private:
+    struct State {
+        IspTransportInterface* transport = nullptr;
+        uint8_t  subCmd = 0;
+        uint32_t total = 0;
+        uint32_t lastSent = 0;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    static void send(uint32_t done) {
+        State& s = state();
+        if (!s.transport) return;
+
+        uint8_t msg[10] = {
+            static_cast<uint8_t>(IspResponse::PROGRESS), s.subCmd,
+            (uint8_t)(done >> 24), (uint8_t)(done >> 16), (uint8_t)(done >> 8), (uint8_t)done,
+            (uint8_t)(s.total >> 24), (uint8_t)(s.total >> 16), (uint8_t)(s.total >> 8), (uint8_t)s.total
+        };
+        volatile uint8_t framed[20];
+        std::size_t frameLen = IspFramingUtils::encodeFrame(msg, sizeof(msg), framed, sizeof(framed));
+        s.transport->transmit(framed, frameLen);
+    }
+};
@@ -7,9 +7,52 @@ enum class IspCommand : uint8_t {
 	RX_DATA_RESET  = 0x53,
 	TX_DATA_RESET  = 0x54,
 	RX_DATA        = 0x55,
-    TX_DATA        = 0x56
+    TX_DATA        = 0x56,
+	RX_DATA_WINDOWED = 0x57,  // RX start with negotiated sliding window
+	TX_DATA_WINDOWED = 0x58   // TX start with streaming window
 };
 
+// Data bytes carried by one RX_DATA/TX_DATA chunk in a v1 frame
+constexpr uint8_t ISP_MAX_CHUNK_SIZE = 56;
+
+// LINK_CAPS response: frame version and a bitmask of the large frame checksums
+constexpr uint8_t ISP_FRAME_VERSION_LARGE = 0x02;
+constexpr uint8_t ISP_CRC_TYPE_CRC16_CCITT = 0x01;
+constexpr uint8_t ISP_CRC_TYPE_CRC32_MPEG2 = 0x02;
+
+// Largest RX window a host may negotiate (width of the out-of-order bitmap)
+constexpr uint8_t ISP_MAX_RX_WINDOW = 32;
+
+// Set in the RX_DATA_WINDOWED window byte to get ACK_BATCH replies; echoed in
+// RX_MODE_ACK when granted
+constexpr uint8_t ISP_RX_WINDOW_ACK_BATCH = 0x80;
+
+// An ACK_BATCH with news goes out after this long without a chunk
+constexpr uint32_t ISP_ACK_BATCH_IDLE_MS = 2;
+
+// Largest number of TX frames kept in flight in streaming mode
+constexpr uint8_t ISP_MAX_TX_WINDOW = 64;
+
+// Cartridge slots on a 4-in-1 board; a *_MULTI subcommand selects them with
+// bit n = slot n+1 and ACK_DONE carries one result code per slot
+constexpr uint8_t ISP_MAX_SLOTS = 4;
+
+// D2_WRITE/D2_WRITE_MULTI/D2_READ: OR'd into the cart number (slot mask)
+// byte.  Writes put ECC in the spare area and read each page back against
+// it, with the result in ACK_DONE; reads correct single-bit errors and fail
+// on anything worse.
+constexpr uint8_t ISP_D2_FLAG_ECC = 0x80;
+
+// Cartridge copy/compare/erase: PROGRESS frames are at least this far apart, and
+// the TX report lists this many mismatches (see IspCartReport.h)
+constexpr uint32_t ISP_PROGRESS_INTERVAL_MS = 100;
+constexpr uint8_t  ISP_CART_REPORT_MAX_ENTRIES = 64;
+constexpr uint16_t ISP_CART_REPORT_SIZE = 7 + 3 * ISP_CART_REPORT_MAX_ENTRIES;
+
+// Dispatch tables map a command or subcommand byte to an index into a
+// handler array; ISP_NO_HANDLER marks an unclaimed byte
+constexpr uint8_t ISP_NO_HANDLER = 0xFF;
+
 // Subcommands
 enum class IspSubCommand : uint8_t {
 
@@ -32,7 +75,18 @@ enum class IspSubCommand : uint8_t {
 	SLOT_LED_BLINK  = 0x10,
 	BLINK_ALL_LED   = 0x11,
 	LOOPBACK_TEST   = 0x12,
-	D3_POWER_CYCLE  = 0x13
+	D3_POWER_CYCLE  = 0x13,
+	LINK_CAPS       = 0x14,
+	D2_WRITE_MULTI  = 0x15,
+	D3_WRITE_MULTI  = 0x16,
+	D2_CART_COPY    = 0x17,
+	D2_CART_COMPARE = 0x18,
+	D3_CART_COPY    = 0x19,
+	D3_CART_COMPARE = 0x1A,
+	D2_ERASE_MULTI  = 0x1B,
+	BUS_BENCHMARK   = 0x1C,  // core cycles of one data bus output/input turnaround, 4 bytes big-endian
+	CRC_BENCHMARK   = 0x1D,  // CRC engine self-check and core cycles per engine, see CrcBenchmark_SubCmdProcess
+	DISPATCH_BENCHMARK = 0x1E   // core cycles of handleData() dispatch, see DispatchBenchmark_SubCmdProcess
 };
 
 // Acknowledgement response types
@@ -44,7 +98,9 @@ enum class IspResponse : uint8_t {
 	RX_MODE_ACK      = 0xA4,
 	RX_MODE_NACK     = 0xA5,
 	TX_MODE_ACK      = 0xA6,
-	TX_MODE_NACK     = 0xA7
+	TX_MODE_NACK     = 0xA7,
+	ACK_BATCH        = 0xA8,  // windowed RX: base seq + received/missing bitmap
+	PROGRESS         = 0xA9   // long-running subcommand: done/total, see IspProgress.h
 };
 
 // Acknowledgement response types
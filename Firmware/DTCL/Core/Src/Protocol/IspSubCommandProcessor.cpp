@@ -6,6 +6,9 @@ IspSubCommandProcessor::IspSubCommandProcessor() : handlerCount(0) {
     for (uint8_t i = 0; i < MAX_HANDLERS; i++) {
         handlers[i].valid = false;
     }
+    for (uint16_t c = 0; c < 256; c++) {
+        dispatch[c] = ISP_NO_HANDLER;
+    }
 }
 
 void IspSubCommandProcessor::registerHandler(uint8_t subCmd, IIspSubCommandHandler* handler) {
@@ -13,17 +16,11 @@ void IspSubCommandProcessor::registerHandler(uint8_t subCmd, IIspSubCommandHandl
         handlers[handlerCount].subCmd = subCmd;
         handlers[handlerCount].handler = handler;
         handlers[handlerCount].valid = true;
-        handlerCount++;
-    }
-}
-
-IIspSubCommandHandler* IspSubCommandProcessor::findHandler(uint8_t subCmd) {
-    for (uint8_t i = 0; i < handlerCount; i++) {
-        if (handlers[i].valid && handlers[i].subCmd == subCmd) {
-            return handlers[i].handler;
+        if (dispatch[subCmd] == ISP_NO_HANDLER) {
+            dispatch[subCmd] = handlerCount;
         }
+        handlerCount++;
     }
-    return nullptr;
 }
 
 uint32_t IspSubCommandProcessor::prepareForRx(uint8_t subCmd, const uint8_t* data, uint32_t len) {
@@ -39,11 +36,10 @@ uint32_t IspSubCommandProcessor::prepareForRx(uint8_t subCmd, const uint8_t* dat
 uint8_t IspSubCommandProcessor::processRxSubCommand(uint8_t subCmd, const uint8_t* data, uint32_t len) {
     IIspSubCommandHandler* handler = findHandler(subCmd);
     if (handler) {
-        handler->processRxData(data, subCmd, len);
-    } else {
-        printf("[RX] No handler for sub command 0x%02X\n", subCmd);
+        return handler->processRxData(data, subCmd, len);
     }
-    return 0;
+    printf("[RX] No handler for sub command 0x%02X\n", subCmd);
+    return 1;
 }
 
 uint8_t IspSubCommandProcessor::prepareTxData(uint8_t subCmd, const uint8_t* data, uint32_t& outLen) {
@@ -55,3 +51,13 @@ uint8_t IspSubCommandProcessor::prepareTxData(uint8_t subCmd, const uint8_t* dat
     outLen = 0;
     return 1;
 }
+
+uint8_t IspSubCommandProcessor::getSlotResults(uint8_t subCmd, uint8_t* codes) {
+    IIspSubCommandHandler* handler = findHandler(subCmd);
+    return handler ? handler->getSlotResults(codes) : 0;
+}
+
+uint32_t IspSubCommandProcessor::rxWriteStep(uint8_t subCmd) {
+    IIspSubCommandHandler* handler = findHandler(subCmd);
+    return handler ? handler->rxWriteStep(subCmd) : 0;
+}
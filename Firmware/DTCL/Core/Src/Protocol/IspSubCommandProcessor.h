@@ -1,5 +1,6 @@
 #pragma once
 #include "IIspSubCommandHandler.h"
+#include "IspProtocolDefs.h"
 
 // Fixed-size handler registry for embedded systems
 constexpr uint8_t MAX_HANDLERS = 16;
@@ -19,9 +20,15 @@ public:
     uint8_t processRxSubCommand(uint8_t subCmd, const uint8_t* data, uint32_t len);
     uint32_t prepareForRx(uint8_t subCmd, const uint8_t* data, uint32_t len);
     uint8_t prepareTxData(uint8_t subCmd, const uint8_t* data, uint32_t& outLen);
+    uint8_t getSlotResults(uint8_t subCmd, uint8_t* codes);
+    uint32_t rxWriteStep(uint8_t subCmd);
 
 private:
-    IIspSubCommandHandler* findHandler(uint8_t subCmd);
+    IIspSubCommandHandler* findHandler(uint8_t subCmd) {
+        uint8_t idx = dispatch[subCmd];
+        return (idx != ISP_NO_HANDLER) ? handlers[idx].handler : nullptr;
+    }
     HandlerEntry handlers[MAX_HANDLERS];
     uint8_t handlerCount;
+    uint8_t dispatch[256];   // subcommand byte -> handlers index
 };
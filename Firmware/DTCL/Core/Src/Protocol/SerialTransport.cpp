@@ -1,10 +1,82 @@
 #include "SerialTransport.h"
 #include "usbd_cdc_if.h"
+#include "main.h"
+#include <atomic>
+
+UsbIspTransport::UsbIspTransport() : head(0), tail(0), inPlace(false), maxDepth(0), drops(0) {
+}
 
 bool UsbIspTransport::transmit(volatile const uint8_t* data, std::size_t len) {
-    return CDC_Transmit_FS((uint8_t*)data, len) == USBD_OK;
+    if (len == 0) return true;
+    if (len > MAX_QUEUED_FRAME) return transmitInPlace(data, len);
+
+    if (queueFree() < len) {
+        drops++;
+        return false;
+    }
+
+    uint16_t h = head;
+    for (std::size_t i = 0; i < len; ++i) {
+        ring[(uint16_t)(h + i) & (TX_RING_SIZE - 1)] = data[i];
+    }
+
+    // Publish the bytes before the new head
+    std::atomic_signal_fence(std::memory_order_release);
+    head = (uint16_t)(h + len);
+
+    uint16_t depth = (uint16_t)queueDepth();
+    if (depth > maxDepth) maxDepth = depth;
+
+    // Start the endpoint if it is idle; otherwise the IN-complete interrupt
+    // picks the bytes up
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (!CDC_IsTxBusy_FS()) sendQueued();
+    __set_PRIMASK(primask);
+    return true;
 }
 
+bool UsbIspTransport::transmitInPlace(volatile const uint8_t* data, std::size_t len) {
+    bool sent = false;
 
+    // Keep frame order: wait for the ring to drain first
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (head == tail && !CDC_IsTxBusy_FS()) {
+        inPlace = true;
+        sent = CDC_Transmit_FS((uint8_t*)data, (uint16_t)len) == USBD_OK;
+        if (!sent) inPlace = false;
+    }
+    __set_PRIMASK(primask);
+    return sent;
+}
+
+void UsbIspTransport::onTxComplete() {
+    inPlace = false;
+    sendQueued();
+}
+
+// Called with the endpoint idle and owned: from the IN-complete interrupt,
+// or from the main loop with interrupts off
+void UsbIspTransport::sendQueued() {
+    uint16_t n = (uint16_t)queueDepth();
+    if (n == 0) return;
+    if (n > TX_PACKET_SIZE) n = TX_PACKET_SIZE;
 
+    std::atomic_signal_fence(std::memory_order_acquire);
+    uint16_t t = tail;
+    for (uint16_t i = 0; i < n; ++i) {
+        packet[i] = ring[(uint16_t)(t + i) & (TX_RING_SIZE - 1)];
+    }
+    tail = (uint16_t)(t + n);
 
+    if (CDC_Transmit_FS(packet, n) != USBD_OK) drops++;
+}
+
+IspTransportStatus UsbIspTransport::status() const {
+    // BUSY while the caller's buffer is on the wire, or while the ring could
+    // not take another frame
+    if (inPlace || queueFree() < MAX_QUEUED_FRAME)
+        return IspTransportStatus::BUSY;
+    return IspTransportStatus::OK;
+}
@@ -12,10 +12,43 @@
 #pragma once
 #include "IspTransportInterface.h"
 
+// Replies are copied into a ring and sent from the IN-complete interrupt,
+// packed several to a 64-byte packet, so transmit() never fails just
+// because the endpoint is busy and the caller's buffer may live on the
+// stack.  Frames too big for the ring (large data chunks) are sent from the
+// caller's buffer once everything queued before them is out; status() stays
+// BUSY until that buffer may be reused.
 class UsbIspTransport : public IspTransportInterface {
 public:
+    static constexpr uint16_t TX_RING_SIZE     = 1024;  // power of two
+    static constexpr uint16_t TX_PACKET_SIZE   = 64;    // one full-speed bulk packet
+    static constexpr std::size_t MAX_QUEUED_FRAME = 260;   // largest v1 frame
+
+    UsbIspTransport();
+
     bool transmit(volatile const uint8_t* data, std::size_t len) override;
+    IspTransportStatus status() const override;
     const char* name() const override { return "USB CDC"; }
+
+    // USB ISR, from CDC_TransmitCplt_FS
+    void onTxComplete();
+
+    std::size_t queueDepth() const { return (uint16_t)(head - tail); }
+    std::size_t queueFree() const { return TX_RING_SIZE - queueDepth(); }
+    uint16_t highWater() const { return maxDepth; }
+    uint32_t dropped() const { return drops; }
+
+private:
+    bool transmitInPlace(volatile const uint8_t* data, std::size_t len);
+    void sendQueued();
+
+    uint8_t ring[TX_RING_SIZE];
+    uint8_t packet[TX_PACKET_SIZE];
+    volatile uint16_t head;       // free-running, written by the main loop only
+    volatile uint16_t tail;       // free-running, written with the endpoint owned
+    volatile bool inPlace;        // the endpoint is sending the caller's buffer
+    volatile uint16_t maxDepth;
+    volatile uint32_t drops;
 };
 
 
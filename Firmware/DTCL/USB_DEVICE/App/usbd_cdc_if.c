@@ -258,15 +258,22 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
   * @param  Len: Number of data received (in bytes)
   * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
   */
-extern void Isp_forward_data(const uint8_t* data, uint32_t len);
+extern uint8_t* Isp_forward_data(const uint8_t* data, uint32_t len);
+extern void Isp_tx_complete(void);
 
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  /* The packet is queued for the main loop, which decodes it in place.
+     The next one lands in the slot handed back; with no free slot the
+     endpoint stays NAKed until the main loop calls CDC_ReceiveInto_FS */
+  uint8_t* next = Isp_forward_data(Buf, *Len);
 
-  Isp_forward_data(Buf, *Len);
+  if (next != NULL)
+  {
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, next);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  }
 
   return (USBD_OK);
   /* USER CODE END 6 */
@@ -316,12 +323,43 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
+  /* The endpoint is free again: send whatever replies queued up meanwhile */
+  Isp_tx_complete();
   /* USER CODE END 13 */
   return result;
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
+/**
+  * @brief  CDC_IsTxBusy_FS
+  *         Reports whether the buffer handed to CDC_Transmit_FS is still
+  *         being sent.
+  * @retval 1 while an IN transfer is in progress, 0 otherwise
+  */
+uint8_t CDC_IsTxBusy_FS(void)
+{
+  USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+  return (hcdc != NULL && hcdc->TxState != 0) ? 1U : 0U;
+}
+
+/**
+  * @brief  CDC_ReceiveInto_FS
+  *         Re-arms the OUT endpoint into Buf from thread context, after
+  *         CDC_Receive_FS left it NAKing for lack of a free buffer.
+  * @param  Buf: Buffer for the next packet (at least one max-size packet)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+uint8_t CDC_ReceiveInto_FS(uint8_t* Buf)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, Buf);
+  uint8_t result = USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  __set_PRIMASK(primask);
+  return result;
+}
+
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
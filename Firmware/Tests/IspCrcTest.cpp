@@ -0,0 +1,112 @@
+// IspCrcTest.cpp - Host test for the IspCrc checksum engines
+//
+// Checks the CRC-8, CRC-16 and CRC-32 table paths against the published
+// check values and against plain bitwise versions, for every length up to a
+// few hundred bytes and for calls split at any point.  The hardware CRC-32
+// path is target-only; CRC_BENCHMARK checks it on the device.
+#include "IspCrc.h"
+#include <cstdio>
+
+static int failures = 0;
+
+#define CHECK_EQ(actual, expected)                                                  \
+    do {                                                                            \
+        unsigned long a_ = (unsigned long)(actual), e_ = (unsigned long)(expected); \
+        if (a_ != e_) {                                                             \
+            printf("%s:%d: %s = 0x%lX, expected 0x%lX\n",                           \
+                   __FILE__, __LINE__, #actual, a_, e_);                            \
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+static const uint8_t kCheck[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+
+static uint16_t crc16Bitwise(const uint8_t* data, std::size_t len, uint16_t crc)
+{
+    for (std::size_t i = 0; i < len; ++i) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int j = 0; j < 8; ++j)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint32_t crc32Bitwise(const uint8_t* data, std::size_t len, uint32_t crc)
+{
+    for (std::size_t i = 0; i < len; ++i) {
+        crc ^= (uint32_t)data[i] << 24;
+        for (int j = 0; j < 8; ++j)
+            crc = (crc & 0x80000000UL) ? ((crc << 1) ^ 0x04C11DB7UL) : (crc << 1);
+    }
+    return crc;
+}
+
+static void testCheckValues()
+{
+    CHECK_EQ(IspCrc::crc8Bitwise(kCheck, sizeof(kCheck), 0x00), 0xF4);
+    CHECK_EQ(IspCrc::crc8Table(kCheck, sizeof(kCheck), 0x00), 0xF4);
+    CHECK_EQ(IspCrc::crc8Slice4(kCheck, sizeof(kCheck), 0x00), 0xF4);
+    CHECK_EQ(IspCrc::crc8(kCheck, sizeof(kCheck), 0x00), 0xF4);
+    CHECK_EQ(IspCrc::crc16(kCheck, sizeof(kCheck), 0xFFFF), 0x29B1);
+    CHECK_EQ(IspCrc::crc32Table(kCheck, sizeof(kCheck), 0xFFFFFFFFUL), 0x0376E6E7UL);
+    CHECK_EQ(IspCrc::crc32(kCheck, sizeof(kCheck)), 0x0376E6E7UL);
+
+    // Nothing to add leaves the running value alone
+    CHECK_EQ(IspCrc::crc8Slice4(kCheck, 0, 0x5A), 0x5A);
+    CHECK_EQ(IspCrc::crc16(kCheck, 0, 0xFFFF), 0xFFFF);
+    CHECK_EQ(IspCrc::crc32Table(kCheck, 0, 0xFFFFFFFFUL), 0xFFFFFFFFUL);
+}
+
+// Every length exercises each slice-by-4 tail, and a non-zero start value
+// covers the running CRC carried between frame fields
+static void testAgainstBitwise()
+{
+    static uint8_t buf[300];
+    for (std::size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (uint8_t)(i * 7 + (i >> 8) + 0x3C);
+
+    for (std::size_t len = 0; len <= sizeof(buf); ++len) {
+        for (int init = 0; init < 256; init += 0x55) {
+            uint8_t ref8 = IspCrc::crc8Bitwise(buf, len, (uint8_t)init);
+            CHECK_EQ(IspCrc::crc8Table(buf, len, (uint8_t)init), ref8);
+            CHECK_EQ(IspCrc::crc8Slice4(buf, len, (uint8_t)init), ref8);
+        }
+        CHECK_EQ(IspCrc::crc16(buf, len, 0xFFFF), crc16Bitwise(buf, len, 0xFFFF));
+        CHECK_EQ(IspCrc::crc16(buf, len, 0x1D0F), crc16Bitwise(buf, len, 0x1D0F));
+        CHECK_EQ(IspCrc::crc32Table(buf, len, 0xFFFFFFFFUL), crc32Bitwise(buf, len, 0xFFFFFFFFUL));
+        CHECK_EQ(IspCrc::crc32Table(buf, len, 0x12345678UL), crc32Bitwise(buf, len, 0x12345678UL));
+    }
+}
+
+static void testSplitCalls()
+{
+    static uint8_t buf[67];
+    for (std::size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (uint8_t)(0xA5 ^ (i * 31));
+
+    uint8_t whole8 = IspCrc::crc8Bitwise(buf, sizeof(buf), 0x00);
+    uint16_t whole16 = IspCrc::crc16(buf, sizeof(buf), 0xFFFF);
+    uint32_t whole32 = IspCrc::crc32Table(buf, sizeof(buf), 0xFFFFFFFFUL);
+
+    for (std::size_t cut = 0; cut <= sizeof(buf); ++cut) {
+        std::size_t rest = sizeof(buf) - cut;
+        CHECK_EQ(IspCrc::crc8Slice4(buf + cut, rest, IspCrc::crc8Slice4(buf, cut, 0x00)), whole8);
+        CHECK_EQ(IspCrc::crc8Table(buf + cut, rest, IspCrc::crc8Table(buf, cut, 0x00)), whole8);
+        CHECK_EQ(IspCrc::crc16(buf + cut, rest, IspCrc::crc16(buf, cut, 0xFFFF)), whole16);
+        CHECK_EQ(IspCrc::crc32Table(buf + cut, rest, IspCrc::crc32Table(buf, cut, 0xFFFFFFFFUL)), whole32);
+    }
+}
+
+int main()
+{
+    testCheckValues();
+    testAgainstBitwise();
+    testSplitCalls();
+
+    if (failures) {
+        printf("IspCrcTest: %d failure(s)\n", failures);
+        return 1;
+    }
+    printf("IspCrcTest: all passed\n");
+    return 0;
+}